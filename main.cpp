@@ -1,43 +1,1058 @@
 #include <iostream>   // Library for input and output operations
+#include <algorithm>  // Library for min, max and sorting helpers
 #include <vector>     // Library for using the vector container
 #include <fstream>    // Library for file operations
 #include <string>     // Library for using strings
+#include <string_view> // Library for titles that point into shared storage
+#include <memory>     // Library for owning arena blocks
+#include <cstdint>    // Library for fixed-width integer types
+#include <cstring>    // Library for memcpy and memcmp
+#include <cstdio>     // Library for formatting file names
+#include <filesystem> // Library for resizing and inspecting files
+#include <thread>     // Library for parsing large files on several threads
+#include <atomic>     // Library for handing out work to threads
+#include <functional> // Library for passing work to the thread helper
+#include <unordered_map> // Library for hash maps
+#include <unordered_set> // Library for hash sets
+#include <charconv>   // Library for fast number parsing and formatting
+#include <mutex>      // Library for guarding the list against the autosave thread
+#include <condition_variable>  // Library for waking the autosave thread
+#include <chrono>     // Library for the autosave interval
+#include <climits>    // Library for integer limits
+#include <ctime>      // Library for today's date
+#include <bit>        // Library for counting bits in scanner masks
+#include <array>      // Library for the radix sort counters
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>  // Library for SSE2 byte comparisons in the import scanner
+#define USE_SSE2
+#endif
+
+// GCC and Clang can compile single functions for AVX2, which is chosen at run time if the processor has it
+#if defined(USE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>  // Library for AVX2 comparisons in the filter kernels
+#define USE_AVX2
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <fcntl.h>     // Library for file open flags
+#include <io.h>        // Library for low-level file writes and flushes
+#include <windows.h>   // Library for replacing files atomically
+#else
+#include <fcntl.h>     // Library for opening files by descriptor
+#include <sys/mman.h>  // Library for memory-mapping files
+#include <sys/stat.h>  // Library for querying file sizes
+#include <unistd.h>    // Library for writing, syncing and closing file descriptors
+#endif
 
 using namespace std;  // Using the standard namespace
 
+// Names of the files the task list is stored in
+const string SHARD_DIRECTORY = "tasks.shards";              // Directory holding one task file per due month
+const string SHARD_INDEX_FILE = "tasks.shards/index.bin";   // List of the shard files, the only file read at startup
+const string BINARY_TASKS_FILE = "tasks.bin";  // Single binary task file of earlier versions, still read for import
+const string TEXT_TASKS_FILE = "tasks.txt";    // Legacy four-lines-per-task file, still read for import
+const string JOURNAL_FILE = "tasks.journal";   // Append-only log of the changes made since the shards were written
+const string JOURNAL_NEXT_FILE = "tasks.journal.next";  // Name the journal takes at every other save, so the next one is opened ahead
+const string JOURNAL_OLD_FILE = "tasks.journal.old";  // Journal moved aside while a save is writing the changes in it
+
+const uint32_t NO_TITLE_HANDLE = UINT32_MAX;  // Handle of a title that has no copy in the title pool
+
+// Struct to represent the title of a task: where its bytes are and, for a copy in the title pool, that copy's handle
+// A title takes 16 bytes, like the string_view it replaces, and reads as a string_view wherever one is expected.
+// Titles typed in, edited or replayed from the journal are copied into the title pool's arena, where a 32-bit
+// handle names the copy, and a title that comes back after its task was deleted or retitled reuses its old copy
+// (see TitlePool). Two titles with the same handle are therefore the same copy and compare equal at once.
+struct TaskTitle {
+    const char* bytes = nullptr;        // First byte of the title
+    uint32_t length = 0;                // Bytes in the title
+    uint32_t handle = NO_TITLE_HANDLE;  // Handle of the title's copy in the title pool, or NO_TITLE_HANDLE
+
+    TaskTitle() = default;
+    explicit TaskTitle(string_view text, uint32_t copyHandle = NO_TITLE_HANDLE)
+        : bytes(text.data()), length(static_cast<uint32_t>(text.size())), handle(copyHandle) {}
+    TaskTitle& operator=(string_view text) { return *this = TaskTitle(text); }
+
+    operator string_view() const { return string_view(bytes, length); }
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+};
+
+inline bool operator==(const TaskTitle& a, const TaskTitle& b) {
+    if (a.handle != NO_TITLE_HANDLE && a.handle == b.handle) return true;  // The same copy
+    return string_view(a) == string_view(b);
+}
+
+inline ostream& operator<<(ostream& out, const TaskTitle& title) { return out << string_view(title); }
+
 // Struct to represent a Task with title, due date, priority, and completion status
+// The due date is kept as a day number and only turned into YYYY-MM-DD text when it is shown, saved or typed in,
+// so a task takes 24 bytes and dates compare as integers.
 struct Task {
-    string title;      // Title of the task
-    string dueDate;    // Due date of the task in YYYY-MM-DD format
-    int priority;      // Priority level of the task (range: 1 to 100, where 1 is lowest and 100 is highest)
-    bool completed;    // Status of the task (true if completed, false otherwise)
+    TaskTitle title;     // Title of the task, pointing into a mapped task file or a title arena
+    uint32_t dueDay;     // Due date as a day number (see dayNumber), or NO_DUE_DAY if the date read was malformed
+    uint8_t priority;    // Priority level of the task (range: 1 to 100, where 1 is lowest and 100 is highest)
+    bool completed : 1;  // Status of the task (true if completed, false otherwise)
+};
+
+const uint32_t NO_DUE_DAY = 0;                     // Day number of a malformed due date
+const char NO_DUE_DATE_TEXT[] = "0000-00-00";      // How a malformed due date is shown and saved
+const uint32_t DAY_NUMBER_SHIFT = 146036;          // Days from March 1 of the year -400, where civilDay counts from, to 0000-01-01, less one
+
+// Class to represent a vector stored in fixed-size chunks that copies share until one side writes to them
+// Copying the vector copies only the chunk pointers, so a snapshot of a million tasks costs a few hundred
+// pointer copies. The first write to a shared chunk gives the writer a private copy of just that chunk and
+// leaves every other copy as it was. Elements are read with operator[] and changed through edit().
+template <typename T>
+class CowVector {
+public:
+    static const size_t CHUNK_SIZE = 4096;  // Elements per chunk
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t index) const { return (*chunks[index / CHUNK_SIZE])[index % CHUNK_SIZE]; }
+    T& edit(size_t index) { return ownChunk(index / CHUNK_SIZE)[index % CHUNK_SIZE]; }
+
+    void push_back(T value) {
+        if (count % CHUNK_SIZE == 0) {
+            chunks.push_back(make_shared<vector<T>>());
+            chunks.back()->reserve(CHUNK_SIZE);
+        }
+        ownChunk(count / CHUNK_SIZE).push_back(move(value));
+        ++count;
+    }
+
+    // Removes the element at 'index', moving every later element down one place
+    void erase(size_t index) {
+        for (size_t i = index; i + 1 < count; ++i) edit(i) = move(edit(i + 1));
+        resize(count - 1);
+    }
+
+    void resize(size_t newCount) {
+        while (count < newCount) push_back(T());
+        if (newCount == count) return;
+        chunks.resize((newCount + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        if (newCount % CHUNK_SIZE != 0) ownChunk(chunks.size() - 1).resize(newCount % CHUNK_SIZE);
+        count = newCount;
+    }
+
+    void clear() {
+        chunks.clear();
+        count = 0;
+    }
+
+private:
+    // Returns chunk 'chunk', first copying it if another vector shares it
+    vector<T>& ownChunk(size_t chunk) {
+        if (chunks[chunk].use_count() > 1) chunks[chunk] = make_shared<vector<T>>(*chunks[chunk]);
+        return *chunks[chunk];
+    }
+
+    vector<shared_ptr<vector<T>>> chunks;  // The elements, CHUNK_SIZE to a chunk
+    size_t count = 0;                      // Number of elements
+};
+
+// Header at the start of the binary task file (all integers are stored little-endian)
+// The header fills the first page of the file. Every column after it starts on a page boundary and has a fixed
+// stride with room for 'capacity' tasks, so a changed task can be saved by overwriting its entries in place:
+//   title refs:   capacity x TitleRef, locating each title inside the title heap
+//   priorities:   capacity x int32_t
+//   completion:   capacity x uint8_t (1 if completed, 0 otherwise)
+//   due dates:    capacity x 10 chars (YYYY-MM-DD, not null-terminated)
+//   positions:    capacity x uint32_t, the place of each task in the whole list
+//   title bloom:  capacity bytes, a bloom filter over the titles so a lookup can skip the file
+//   title heap:   titles back to back up to 'titleHeapEnd'; a changed title is appended here
+// Version 2 files had no positions or title bloom; they are still read. Version 1 files had no spare capacity, stored the title blob size where 'capacity' is now and used
+// (taskCount + 1) uint64_t offsets right after a 32-byte header instead of title refs. They are still read.
+struct BinaryFileHeader {
+    char magic[4];           // File signature, always "TDLB"
+    uint32_t version;        // Version of the file format
+    uint64_t taskCount;      // Number of tasks stored in the file
+    uint64_t capacity;       // Number of tasks each column has room for
+    uint64_t journalSeq;     // Sequence number of the last journal record already included in this file
+    uint64_t titleHeapEnd;   // File offset just past the last title in the title heap
+    uint64_t garbageBytes;   // Bytes of the title heap that no task refers to any more
+};
+
+// Struct to represent where one title is stored in the title heap of the binary task file
+struct TitleRef {
+    uint64_t offset;    // File offset of the first byte of the title
+    uint32_t length;    // Length of the title in bytes
+    uint32_t reserved;  // Padding, always 0
+};
+
+// Struct to represent the file offsets of the columns of a binary task file with a given capacity
+struct BinaryLayout {
+    uint64_t titleRefs;   // Start of the title ref column
+    uint64_t priorities;  // Start of the priority column
+    uint64_t completion;  // Start of the completion column
+    uint64_t dueDates;    // Start of the due date column
+    uint64_t positions;   // Start of the position column
+    uint64_t titleBloom;  // Start of the title bloom filter
+    uint64_t titleHeap;   // Start of the title heap
+};
+
+const char BINARY_FILE_MAGIC[4] = {'T', 'D', 'L', 'B'};  // Signature of the binary task file
+const uint32_t BINARY_FILE_VERSION = 3;                  // Current version of the binary task file
+const size_t DUE_DATE_LENGTH = 10;                       // Length of a YYYY-MM-DD date string
+const uint64_t FILE_PAGE_BYTES = 4096;                   // Alignment of the header and of every column
+const uint64_t MIN_SNAPSHOT_CAPACITY = 1024;             // Smallest number of task slots reserved in a new file
+const size_t V1_HEADER_BYTES = 32;                       // Size of the header of version 1 files
+
+// Header at the start of a compressed task file (all integers are stored little-endian)
+// The header is followed by the date dictionary (dateCount x 10 chars, every distinct due date once),
+// the block directory (blockCount x CompressedBlockInfo), the title bloom filter (bloomBytes) and the
+// compressed blocks. Each block holds up to COMPRESSED_BLOCK_TASKS consecutive tasks and is compressed on
+// its own, so blocks can be unpacked in parallel. Unpacked, a block of n tasks holds: n x uint32_t date codes
+// (dictionary positions), n x int32_t priorities, n x uint32_t title lengths, n x uint32_t positions in the
+// whole list, n x uint8_t completion flags, and then the titles back to back.
+// Version 1 files had a 32-byte header without 'bloomBytes' and no positions; they are still read.
+struct CompressedFileHeader {
+    char magic[4];        // File signature, always "TDLZ"
+    uint32_t version;     // Version of the file format
+    uint64_t taskCount;   // Number of tasks stored in the file
+    uint64_t journalSeq;  // Sequence number of the last journal record already included in this file
+    uint32_t blockCount;  // Number of compressed blocks
+    uint32_t dateCount;   // Number of entries in the date dictionary
+    uint64_t bloomBytes;  // Size of the title bloom filter
+};
+
+// Struct to represent where one compressed block is stored and how large it is unpacked
+struct CompressedBlockInfo {
+    uint64_t offset;          // File offset of the compressed bytes
+    uint32_t compressedSize;  // Size of the compressed bytes
+    uint32_t rawSize;         // Size of the block once unpacked
+    uint32_t taskCount;       // Number of tasks in the block
+    uint32_t reserved;        // Padding, always 0
+};
+
+const char COMPRESSED_FILE_MAGIC[4] = {'T', 'D', 'L', 'Z'};  // Signature of the compressed task file
+const uint32_t COMPRESSED_FILE_VERSION = 2;                  // Current version of the compressed task file
+const size_t COMPRESSED_V1_HEADER_BYTES = 32;                // Size of the header of version 1 compressed files
+const size_t COMPRESSED_BLOCK_TASKS = 1 << 16;               // Tasks per compressed block
+const int LZ_HASH_BITS = 16;                                 // Size of the match finder table, as a power of two
+const size_t LZ_MIN_MATCH = 4;                               // Shortest repeat worth encoding as a match
+const size_t LZ_MAX_OFFSET = 65535;                          // Furthest back a match may point
+
+// Bits recording how a task differs from its copy in its task file
+enum DirtyFlag : uint8_t {
+    DIRTY_FIELDS = 1,  // Due date, priority or completion changed
+    DIRTY_TITLE = 2    // Title changed and has to be appended to the title heap
+};
+
+// Struct to represent a task file as last written, so a save only has to write what changed since
+struct SnapshotState {
+    bool updatable = false;       // True if the file on disk is a current binary task file described by this state
+    uint64_t taskCount = 0;       // Tasks recorded in the file
+    uint64_t capacity = 0;        // Task slots reserved in each column of the file
+    uint64_t titleHeapEnd = 0;    // File offset where the next title is appended
+    uint64_t garbageBytes = 0;    // Title heap bytes no task refers to any more
+    vector<uint8_t> dirtyFlags;   // DirtyFlag bits for each slot of the file
+    vector<uint32_t> dirtyTasks;  // Slots whose dirty flags are set, in the order they first changed
+};
+
+// Struct to represent bytes to be written at a given offset of an existing file
+struct FilePatch {
+    uint64_t offset;     // File offset of the first byte
+    vector<char> bytes;  // Bytes to write
+};
+
+// Kinds of change recorded in the journal
+enum JournalOp : uint8_t {
+    JOURNAL_ADD = 1,       // A task was appended to the list
+    JOURNAL_EDIT = 2,      // The task at 'index' was replaced with new details
+    JOURNAL_DELETE = 3,    // The task at 'index' was removed
+    JOURNAL_COMPLETE = 4,  // The task at 'index' was marked as completed
+    JOURNAL_SORT = 5       // The whole list was sorted by 'sortKey'
+};
+
+// Orders the list can be sorted in
+// Records written by earlier versions hold the exchange sort keys; they are replayed with the exchange sort that
+// made them, because it does not keep equal tasks in order and later records refer to the order it left.
+enum SortKey : uint8_t {
+    SORT_BY_PRIORITY_EXCHANGE = 1,  // Ascending priority, by the exchange sort
+    SORT_BY_DUE_DATE_EXCHANGE = 2,  // Ascending due date, by the exchange sort
+    SORT_BY_PRIORITY = 3,           // Ascending priority; equal tasks keep their order
+    SORT_BY_DUE_DATE = 4,           // Ascending due date; equal tasks keep their order
+    SORT_BY_FIELDS = 5              // By the record's sort fields; equal tasks keep their order
+};
+
+// Fields a sort can order by. A sort lists up to MAX_SORT_FIELDS of them, most significant first, each
+// optionally combined with SORT_DESCENDING; unused entries are SORT_FIELD_NONE.
+enum SortField : uint8_t {
+    SORT_FIELD_NONE = 0,      // No field
+    SORT_FIELD_PRIORITY = 1,  // Priority
+    SORT_FIELD_DUE_DATE = 2,  // Due date; malformed dates come before every valid one
+    SORT_FIELD_STATUS = 3     // Status, pending before completed
+};
+
+const size_t MAX_SORT_FIELDS = 3;       // Most fields a sort can order by
+const size_t EXCHANGE_BENCHMARK_TASKS = 20000;  // Most tasks --benchmark-sort gives the exchange sort
+const uint8_t SORT_DESCENDING = 0x80;   // Flag on a sort field that reverses its order
+
+// Struct to represent one change to the task list, as applied in memory and stored in the journal
+// On disk each record is framed as: uint32_t payload size, uint32_t checksum of the payload, payload.
+// The payload holds op, seq and index, followed by the task details (add/edit) or the sort key (sort), which
+// for SORT_BY_FIELDS is followed by the MAX_SORT_FIELDS sort fields.
+struct JournalRecord {
+    JournalOp op;        // Kind of change
+    uint64_t seq = 0;    // Sequence number, increasing by one with every change
+    uint32_t index = 0;  // Zero-based position of the task the change applies to
+    Task task;           // New task details for add and edit records
+    SortKey sortKey = SORT_BY_PRIORITY;  // Order used by sort records
+    uint8_t sortFields[MAX_SORT_FIELDS] = {};  // Fields sorted by when 'sortKey' is SORT_BY_FIELDS
+};
+
+const char JOURNAL_FILE_MAGIC[4] = {'T', 'D', 'L', 'J'};  // Signature of the journal file
+const uint32_t JOURNAL_FILE_VERSION = 1;                  // Current version of the journal file
+const size_t JOURNAL_HEADER_SIZE = 8;                     // Magic followed by the version
+const uint64_t JOURNAL_COMPACTION_BYTES = 4 << 20;        // Journal size that triggers writing a new tasks.bin
+const size_t WRITE_CHUNK_BYTES = 64 << 20;                // Largest single write issued when saving a file
+const size_t MIN_PARSE_CHUNK_BYTES = 1 << 20;             // Smallest piece of a text file worth giving its own thread
+
+// Struct to represent a read-only view of a whole file in memory
+struct MappedFile {
+    const char* data = nullptr;  // First byte of the file contents
+    size_t size = 0;             // Size of the file in bytes
+#ifdef _WIN32
+    vector<char> buffer;         // Windows builds read the file into this buffer instead of mapping it
+#endif
+};
+
+// Struct to represent an append-only store for titles that do not live in a mapped task file
+// Blocks are never moved or freed, so the titles handed out stay valid for the whole run.
+struct TitleArena {
+    vector<unique_ptr<char[]>> blocks;  // Memory blocks holding the titles
+    size_t used = 0;                    // Bytes used in the last block
+    size_t capacity = 0;                // Size of the last block
+};
+
+const size_t TITLE_ARENA_BLOCK_BYTES = 64 << 10;  // Size of a regular title arena block
+
+// Struct to represent the copies of the titles typed in, edited or replayed from the journal
+// Such titles are copied into the pool's arena, where a 32-bit handle names each copy: its block above the low 16
+// bits and its offset in the block below them. When a task holding one is deleted or retitled, its copy enters a
+// hash table of the titles let go, so a recurring chore that is added again, or the replay of a journal full of
+// such records, reuses the copy and its handle instead of making another. A title still in use never needs the
+// table, since the duplicate check turns it away, so a list of distinct titles pays only for the copies.
+struct TitlePool {
+    TitleArena arena;        // Every typed, edited or replayed title
+    vector<uint64_t> slots;  // Length of a title let go above its handle plus one, or 0 if empty
+    size_t count = 0;        // Number of titles in the table
+};
+
+
+// Formats of the files used to exchange tasks with other systems
+enum ExchangeFormat {
+    FORMAT_CSV,    // Comma-separated values, one task per record: title,dueDate,priority,completed
+    FORMAT_NDJSON  // One JSON object per line with the keys "title", "dueDate", "priority" and "completed"
+};
+
+// Struct to represent the raw fields of one imported record before they are checked
+// A field the record does not have keeps a null data pointer; an empty field points into the file.
+struct ImportFields {
+    string_view title;      // Title, already unescaped
+    string_view dueDate;    // Due date as written
+    string_view priority;   // Priority as written
+    string_view completed;  // Completion status as written (1/0, true/false or yes/no); optional
+};
+
+// Struct to represent where each task field sits in the records of a CSV file
+struct CsvColumns {
+    int title = 0;      // Field number of the title
+    int dueDate = 1;    // Field number of the due date
+    int priority = 2;   // Field number of the priority
+    int completed = 3;  // Field number of the completion status, or -1 if the file has none
+};
+
+// States of the scan that finds where CSV records start, following the rules splitCsvRecord reads them by
+enum CsvScanState : uint8_t {
+    CSV_RECORD_START,  // At the start of a record
+    CSV_FIELD_START,   // At the start of a field after a comma
+    CSV_UNQUOTED,      // Inside an unquoted field, or past the closing quote of a malformed one; quotes are literal here
+    CSV_QUOTED,        // Inside a quoted field
+    CSV_QUOTE_SEEN,    // Just past a quote inside a quoted field, which closes it unless another quote follows
+    CSV_AFTER_CR,      // Just past a carriage return that ended a record; a line feed right after it belongs to it
+    CSV_SCAN_STATES    // Number of states
+};
+
+// Next CSV scan state for each state and a quote, a comma, a line feed, a carriage return or any other byte
+const uint8_t CSV_TRANSITIONS[CSV_SCAN_STATES][5] = {
+    {CSV_QUOTED, CSV_FIELD_START, CSV_RECORD_START, CSV_AFTER_CR, CSV_UNQUOTED},    // CSV_RECORD_START
+    {CSV_QUOTED, CSV_FIELD_START, CSV_RECORD_START, CSV_AFTER_CR, CSV_UNQUOTED},    // CSV_FIELD_START
+    {CSV_UNQUOTED, CSV_FIELD_START, CSV_RECORD_START, CSV_AFTER_CR, CSV_UNQUOTED},  // CSV_UNQUOTED
+    {CSV_QUOTE_SEEN, CSV_QUOTED, CSV_QUOTED, CSV_QUOTED, CSV_QUOTED},              // CSV_QUOTED
+    {CSV_QUOTED, CSV_FIELD_START, CSV_RECORD_START, CSV_AFTER_CR, CSV_UNQUOTED},    // CSV_QUOTE_SEEN
+    {CSV_QUOTED, CSV_FIELD_START, CSV_RECORD_START, CSV_AFTER_CR, CSV_UNQUOTED},    // CSV_AFTER_CR
+};
+
+// Struct to represent an imported record that was rejected
+struct ImportProblem {
+    size_t offset;       // Byte offset of the record in the file
+    const char* reason;  // What was wrong with it
+};
+
+// Struct to represent the records parsed by one import thread
+struct ImportBatch {
+    vector<Task> tasks;              // Valid records in file order
+    vector<uint64_t> titleHashes;    // hashTitle of each of their titles
+    TitleArena arena;                // Copies of their titles
+    size_t invalid = 0;              // Number of records rejected
+    vector<ImportProblem> problems;  // The first few rejected records
+    size_t firstRecord = SIZE_MAX;   // Offset of the first record parsed, or SIZE_MAX if none starts in the range
+    size_t recordsEnd = 0;           // Offset just past the last record parsed
+};
+
+const size_t MAX_REPORTED_PROBLEMS = 5;          // Rejected records listed by line after an import
+const size_t TITLE_PREFETCH_DISTANCE = 32;       // Titles ahead whose title index slot is requested early
+const size_t MIN_THREAD_TASKS = 1 << 16;         // Smallest share of the list worth giving its own thread
+
+// Struct to represent the contents of one task file as read by readTaskFile
+struct TaskFileContents {
+    vector<Task> tasks;                 // Tasks in file order
+    vector<uint32_t> positions;         // Place of every task in the whole list (current versions only)
+    vector<uint8_t> titleBloom;         // Bloom filter over the titles (current versions only)
+    SnapshotState state;                // How the file can be updated in place
+    uint64_t journalSeq = 0;            // Journal sequence number recorded in the file
+    bool compressed = false;            // True if the file is a compressed container
+    MappedFile mapping;                 // Mapping the titles point into, for uncompressed files
+    vector<unique_ptr<char[]>> blocks;  // Unpacked blocks the titles point into, for compressed files
+};
+
+// Header at the start of the shard index (all integers are stored little-endian)
+// The header is followed by shardCount x ShardIndexEntry, then by each entry's dead rows as uint32_t file slots in
+// ascending order, entry by entry. The index is replaced atomically after the shard files it lists have been
+// written, so it is the commit point of every save, deletes included.
+struct ShardIndexHeader {
+    char magic[4];            // File signature, always "TDLS"
+    uint32_t version;         // Version of the file format
+    uint64_t taskCount;       // Number of task rows in all shards together, dead rows included
+    uint64_t journalSeq;      // Sequence number of the last journal record already included in the shards
+    uint64_t nextGeneration;  // Number for the next shard file to be written
+    uint32_t shardCount;      // Number of entries after the header
+    uint32_t flags;           // ShardIndexFlag bits
+};
+
+// Struct to represent one shard as listed in the shard index
+struct ShardIndexEntry {
+    uint32_t month;        // Due month of the tasks in the shard as YYYYMM, or 0 for dates without a readable month
+    uint32_t deadCount;    // Number of dead rows listed for the shard after the entries; always 0 in version 1
+    uint64_t generation;   // Number in the name of the shard's file
+    uint64_t taskCount;    // Number of task rows in the shard, dead rows included
+    uint64_t bloomOffset;  // File offset of the shard's title bloom filter
+    uint64_t bloomBytes;   // Size of the shard's title bloom filter
+};
+
+// Bits of the 'flags' field of the shard index
+enum ShardIndexFlag : uint32_t {
+    SHARD_INDEX_COMPRESSED = 1  // The shard files are compressed containers
+};
+
+const char SHARD_INDEX_MAGIC[4] = {'T', 'D', 'L', 'S'};  // Signature of the shard index
+const uint32_t SHARD_INDEX_VERSION = 2;                  // Current version of the shard index
+const uint32_t TITLE_BLOOM_PROBES = 4;                   // Bits set in a title bloom filter for every title
+
+// Struct to represent one shard: the tasks due in one calendar month, stored in a file of their own
+struct Shard {
+    uint32_t month = 0;          // Due month as YYYYMM, or 0 for dates without a readable month
+    uint64_t generation = 0;     // Number in the name of the shard's file, or 0 if it has no file yet
+    uint64_t storedCount = 0;    // Tasks the shard index lists for the file
+    uint64_t bloomOffset = 0;    // File offset of the title bloom filter
+    uint64_t bloomBytes = 0;     // Size of the title bloom filter
+    bool rewrite = false;        // True if the file has to be written whole at the next save
+    SnapshotState file;          // State of the file for in-place updates, once the shard is loaded
+    vector<uint32_t> members;    // Position in 'tasks' of the task in each slot of the file, once loaded
+    vector<uint32_t> deadRows;   // Slots holding deleted tasks; in ascending order while only the index is loaded
+    vector<uint8_t> titleBloom;  // Copy of the title bloom filter, read on first use
+};
+
+// Struct to represent the shard files and how the tasks in memory map onto them
+struct ShardStore {
+    bool loaded = true;            // False while only the shard index has been read
+    bool compressed = false;       // True if the shard files are compressed containers
+    uint64_t taskCount = 0;        // Number of live tasks while the shards are not loaded
+    uint64_t nextGeneration = 1;   // Number for the next shard file to be written
+    vector<Shard> shards;          // Every shard, in index order
+    unordered_map<uint32_t, uint32_t> shardOfMonth;  // Position in 'shards' of the shard for each due month
+    vector<uint32_t> taskShard;    // Shard of every task in 'tasks'
+    vector<uint32_t> taskSlot;     // Slot of every task in its shard's file
+    vector<JournalRecord> pendingRecords;  // Journal records waiting for the shards to be loaded
+    vector<string> retiredFiles;   // Shard files to delete once the next index is written
+};
+
+// Struct to represent a save, prepared while the list is locked and written while it is not
+// Everything the writing needs is copied or shared here, so the list can keep changing in the meantime.
+struct SaveJob {
+    CowVector<Task> tasks;              // Snapshot of the list, sharing its chunks with 'tasks' until either side writes
+    uint64_t journalSeq = 0;            // Sequence number of the last change in the snapshot
+    uint64_t changes = 0;               // Changes the snapshot covers that were not saved before
+    uint64_t nextGeneration = 0;        // Number for the next shard file, for the new index
+    bool compressed = false;            // True if the shard files are written as compressed containers
+    vector<uint32_t> shardNumbers;      // Position in 'shardStore.shards' of every shard to be written
+    vector<Shard> shards;               // Copies of those shards, holding the changes claimed from them
+    vector<uint64_t> generations;       // Number reserved for a new file of each of those shards
+    vector<ShardIndexEntry> unchanged;  // Index entries of the shards that need no writing
+    vector<vector<uint32_t>> unchangedDeadRows;  // Dead rows of each of those shards
+    vector<string> retiredFiles;        // Shard files to delete once the new index is written
+    ofstream journal;                   // Journal the snapshot covers, handed over to be moved aside, if it was switched
+    string journalName;                 // Name of that journal, or empty if the journal carries on
+    ofstream spareJournal;              // Empty journal opened under that name for the save after this one
+};
+
+// Results of looking up a title without loading the shards
+enum TitleLookup {
+    TITLE_ABSENT,   // No task has the title
+    TITLE_PRESENT,  // A task has the title
+    TITLE_UNKNOWN   // Only the whole list can tell
+};
+
+// Struct to represent a hash index from task titles to their positions in the list
+// The table uses open addressing with linear probing. Each slot holds the upper half of the title's hashTitle and
+// the task's position plus one, or 0 if it is empty, so a probe only compares titles when the hashes agree. The
+// table is kept at most half full.
+struct TitleIndex {
+    vector<uint64_t> slots;  // Hash tags and positions; the size is a power of two
+    size_t count = 0;        // Number of titles in the table
+    bool built = false;      // True while the table covers the whole list
+};
+
+const size_t NO_TASK = SIZE_MAX;  // Position returned when no task has a title
+
+// Struct to represent an ordered index of the tasks by due date
+// Each entry packs the due day (NO_DUE_DAY for a malformed date) above the task's position, so ordering the
+// entries orders the tasks by due date and then by position. Most entries sit in one large sorted array; entries
+// added since it was last rebuilt go to a small sorted delta buffer that is merged in once it fills up, so an
+// insertion never moves the whole array. A range query binary-searches both and walks them side by side. Taking an
+// entry out would move the array too, so a new due date only adds the task's new entry, as the sorted views do: an
+// entry counts only while its slot is live and its day is still the task's, and the merge drops the rest.
+struct DueDateIndex {
+    vector<uint64_t> sorted;  // Sorted entries
+    vector<uint64_t> recent;  // Sorted entries added since the last merge
+    bool built = false;       // True while the index covers the whole list
+};
+
+const size_t DUE_DATE_DELTA_LIMIT = 1024;  // Entries the delta buffer holds before it is merged
+
+const int MIN_PRIORITY = 1;                               // Lowest valid priority
+const int MAX_PRIORITY = 100;                             // Highest valid priority
+const size_t PRIORITY_BUCKETS = MAX_PRIORITY + 1;         // One bucket per valid priority; bucket 0 stays empty
+
+// Struct to represent an index of the tasks by priority and status
+// Bucket b holds the positions of the tasks with priority b, pending and completed tasks apart. Each task's place
+// in its bucket is stored, so a task leaves its bucket by moving the bucket's last entry into its place and joins
+// one at the end, both in O(1). Either may leave a bucket out of order; the bucket is sorted again when a listing
+// next reads it. A bitmap per status marks the buckets that are not empty, so the highest occupied priority is
+// found with a count of leading zeros.
+struct PriorityIndex {
+    vector<uint32_t> buckets[2][PRIORITY_BUCKETS];  // Positions by status (1 if completed) and priority
+    vector<uint32_t> places;                        // Place of each indexed task's position in its bucket
+    bool unordered[2][PRIORITY_BUCKETS] = {};       // True for a bucket whose positions may be out of order
+    uint64_t occupied[2][2] = {};                   // Bit b % 64 of word b / 64 is set if bucket b is not empty
+    bool built = false;                             // True while the index covers the whole list
+};
+
+// Struct to represent the fields filters test, stored one array per field
+// Position i of every column belongs to task i, so a filter streams through five bytes and a bit per task and
+// never touches the titles. Completion is a bitmap, so the number of completed tasks, overall or among the tasks
+// of a selection bitmap, is a popcount per 64 tasks.
+struct TaskColumns {
+    vector<uint32_t> dueDays;    // Due day of every task
+    vector<uint8_t> priorities;  // Priority of every task
+    vector<uint64_t> completed;  // Bit i % 64 of word i / 64 is set if task i is completed; later bits are clear
+    bool built = false;          // True while the columns cover the whole list
+};
+
+// Struct to represent a filter over the task columns; a task matches if each of its fields lies in the range
+struct TaskFilter {
+    uint32_t firstDay = 0;            // Earliest due day
+    uint32_t lastDay = UINT32_MAX;    // Latest due day
+    uint8_t minPriority = MIN_PRIORITY;  // Lowest priority; dead slots hold DEAD_SLOT_PRIORITY, below any filter's
+    uint8_t maxPriority = UINT8_MAX;  // Highest priority
+    uint8_t minCompleted = 0;         // 1 to match completed tasks only
+    uint8_t maxCompleted = 1;         // 0 to match pending tasks only
+};
+
+// Function type of the filter kernels, which test 'count' tasks and set bit i % 64 of selection[i / 64] for
+// every match; they differ only in the instructions they use
+using FilterKernel = void (*)(const uint32_t* dueDays, const uint8_t* priorities, const uint64_t* completed,
+                              size_t count, const TaskFilter& filter, uint64_t* selection);
+
+// Function type of the bit counters, which count the bits set in 'count' words, after an AND with 'mask' if given
+using BitCounter = size_t (*)(const uint64_t* words, const uint64_t* mask, size_t count);
+
+const size_t FILTER_BLOCK_TASKS = 1 << 16;  // Tasks per piece of work when a filter runs on several threads
+
+// Steps of a compiled filter query
+enum QueryOp : uint8_t {
+    QUERY_TEST = 1,  // Pushes the tasks that match range test 'test'
+    QUERY_AND = 2,   // Replaces the top two results with the tasks in both
+    QUERY_OR = 3     // Replaces the top two results with the tasks in either
+};
+
+// Struct to represent one step of a compiled filter query
+struct QueryStep {
+    QueryOp op;         // What the step does
+    uint32_t test = 0;  // Range test a QUERY_TEST step runs, as an index into the query's tests
+};
+
+// Struct to represent a filter query compiled into a flat program
+// A query such as "priority>=50 and due<2026-01-01 and not done" is parsed once into range tests, each a
+// TaskFilter the filter kernels run, and a postfix program that combines their results. Each 'not' is pushed down
+// to the comparisons while parsing, where it turns a range into what lies outside it, so the program never
+// negates a result; and an 'and' of two range tests folds into one, so a query without 'or' or '!=' compiles to a
+// single test. The program runs over the task columns FILTER_BLOCK_TASKS tasks at a time, on a stack of block
+// bitmaps. A test that an index narrows down to few tasks is answered from the index instead, before the blocks run.
+struct TaskQuery {
+    vector<TaskFilter> tests;   // Range tests
+    vector<QueryStep> program;  // Steps in postfix order
+};
+
+// Struct to represent the state of the filter query parser
+struct QueryParser {
+    string_view text;        // Query being parsed, in lower case
+    size_t position = 0;     // Offset in 'text' where the next token starts, or the spaces before it
+    size_t nesting = 0;      // Parentheses and 'not's the parser is inside
+    TaskQuery* query;        // Query being compiled
+    string error;            // Why the query was rejected
+};
+
+const size_t MAX_QUERY_NESTING = 100;  // Deepest a query may nest parentheses and 'not's
+const size_t QUERY_INDEX_RATIO = 64;   // An index answers a test if the test leaves this many times fewer tasks to check than a scan
+
+// Struct to represent the slots of deleted tasks that are still in the list
+// A delete only marks the task's slot dead, so it costs the same wherever the task is. Dead slots stay in 'tasks',
+// and in the shard files, where the shard index lists them, until compactTasks drops them all at once on the
+// autosave thread once one slot in TOMBSTONE_COMPACTION_RATIO is dead. The indexes and columns keep using slots,
+// while the menu and the journal number the live tasks only. While any slot is dead, a bitmap marks the live slots
+// and a Fenwick tree sums the bitmap's words, so a task number and its slot convert into each other in O(log n).
+struct Tombstones {
+    vector<uint64_t> live;  // Bit i % 64 of word i / 64 is set if slot i holds a live task; empty while none is dead
+    vector<uint32_t> sums;  // Fenwick tree over the live slots per word; node w sums words w - (w & -w) to w - 1
+    size_t deadCount = 0;   // Number of dead slots
+};
+
+const size_t TOMBSTONE_COMPACTION_RATIO = 4;  // The list is compacted once more than one slot in this many is dead
+const uint8_t DEAD_SLOT_PRIORITY = 0;         // Priority a dead slot holds in the task columns
+
+// Struct to represent a generational slot map from task IDs to slots
+// A task's number changes whenever a sort or delete moves it; its ID does not. An ID names an entry of the map
+// and the entry's generation when the ID was handed out, packed as generation << 32 | entry. The entry holds the
+// task's current slot, so an ID resolves with one lookup. A delete frees the entry and advances its generation, so
+// the entry can serve a new task while the old ID is recognized as stale. IDs are handed out in list order when
+// the map is built and last until the program exits.
+struct TaskIdEntry {
+    uint32_t slot;        // Slot in 'tasks' of the entry's task, or NO_ID while the entry is free
+    uint32_t generation;  // Number of tasks that have held the entry before
+};
+
+struct TaskIdMap {
+    vector<TaskIdEntry> entries;   // Every entry handed out so far
+    vector<uint32_t> entryOfSlot;  // Entry of the task in each slot of 'tasks', or NO_ID for a dead slot
+    vector<uint32_t> freeEntries;  // Entries of deleted tasks, reused last freed first
+    bool built = false;            // True while the map covers the whole list
 };
 
+const uint32_t NO_ID = UINT32_MAX;  // Slot of a free entry, and entry of a dead slot, in the task ID map
+
+// Struct to represent an inverted index from the three-byte pieces of the titles to the tasks holding them
+// A title is indexed under every run of three bytes in it, ASCII letters folded to lower case. The trigrams are
+// hashed into TRIGRAM_BUCKETS posting lists, each holding slots in ascending order without repeats, so a search
+// intersects the lists of the query's trigrams and checks only the tasks left against their titles. Sharing a
+// list between trigrams only adds candidates that the check throws out. Taking a slot out of a list, or putting one
+// into its middle, would move the rest of the list, so a delete or a new title leaves the old entries behind for the
+// check to throw out, and a task retitled anywhere but at the end of the list goes on a short list of its own that
+// every search checks directly. Once the entries left behind reach half of all entries, or the retitled tasks fill
+// their list, the index is built afresh by the next search.
+struct TrigramIndex {
+    vector<vector<uint32_t>> postings;  // Slots of the tasks whose titles held a trigram of each bucket
+    vector<uint32_t> retitled;          // Slots whose current titles are not in the lists, in ascending order
+    size_t entries = 0;                 // Entries in the lists
+    size_t staleEntries = 0;            // Entries left behind by deletes and new titles, counted per trigram
+    bool built = false;                 // True while the index covers the whole list
+};
+
+const int TRIGRAM_BUCKET_BITS = 18;                        // Number of posting lists, as a power of two
+const size_t TRIGRAM_BUCKETS = size_t(1) << TRIGRAM_BUCKET_BITS;  // Number of posting lists
+const size_t TRIGRAM_LENGTH = 3;                           // Bytes in a trigram; shorter queries scan the titles
+const size_t TRIGRAM_BUILD_BATCH = 1 << 16;                // Titles whose entries are grouped together while the index is built
+const size_t TRIGRAM_RETITLED_LIMIT = 4096;                // Retitled tasks searched one by one before the index is rebuilt
+const int TRIGRAM_GROUP_BITS = 8;                          // Groups those entries are sorted into, as a power of two
+
+// Struct to represent a radix trie of the task titles, for completing titles and suggesting similar ones
+// Each node stands for the bytes on the path from the root to it. Its label, the bytes on the edge into it,
+// points into a title that starts with that path, so the trie copies no title bytes. A node's children are
+// linked through their siblings in ascending order of their first byte, and a node where a title ends holds the
+// slot of its task. A delete unlinks a node that no longer leads to a title and merges a node left with one child
+// and no title into the child, so every node but the root ends a title or branches, and there are fewer than two
+// nodes per title.
+struct TrieNode {
+    const char* label = nullptr;  // Bytes on the edge into the node
+    uint32_t labelLength = 0;     // Number of bytes on the edge; 0 only for the root
+    uint32_t firstChild = NO_ID;  // Child with the lowest first byte, or NO_ID
+    uint32_t nextSibling = NO_ID; // Next child of the same parent, or NO_ID
+    uint32_t slot = NO_ID;        // Slot of the task whose title ends here, or NO_ID
+};
+
+struct TitleTrie {
+    vector<TrieNode> nodes;       // Every node; node 0 is the root
+    vector<uint32_t> freeNodes;   // Nodes unlinked by deletes, reused last freed first
+    bool built = false;           // True while the trie covers the whole list
+};
+
+const char COMPLETION_KEY = '\t';          // Ending a typed title with this lists the titles it starts
+const size_t COMPLETION_LIMIT = 10;        // Most titles listed for a completion
+const size_t SUGGESTION_LIMIT = 3;         // Most similar titles suggested
+const size_t MAX_SUGGESTION_DISTANCE = 2;  // Most single-byte edits between a typed title and a suggested one
+
+// Struct to represent the tasks in the order of some sort fields, kept up to date instead of sorting the list
+// Each entry packs the task's packSortKey above its slot, so ordering the entries orders the tasks by the fields
+// and then by list position, as the stable sort did. Like the due date index, most entries sit in a large sorted
+// array and new ones go to a small sorted delta buffer that is merged in once it fills up. An add, edit or
+// completion only inserts the task's current entry, so the entries a task held before are left behind; an
+// entry counts only while its slot is live and its key is still the task's, and the merge drops the rest. A view
+// is built when it is first shown.
+struct SortedView {
+    uint8_t fields[MAX_SORT_FIELDS] = {};  // Sort fields the view orders by
+    vector<uint64_t> sorted;               // Sorted entries
+    vector<uint64_t> recent;               // Sorted entries added since the last merge
+    bool built = false;                    // True while the view covers the whole list
+};
+
+const size_t VIEW_DELTA_LIMIT = 1024;  // Entries a view's delta buffer holds before it is merged
+const size_t MAX_SORTED_VIEWS = 4;     // Views kept up to date at once; choosing another drops the oldest
+const size_t LIST_ORDER = SIZE_MAX;    // View number of the list in its own order
+
+// Struct to represent counters over the live tasks, so the progress and the statistics are read, not computed
+// Every change adjusts the counters of the task as it was and as it is, which costs the same for any list size;
+// only the pending tasks with a valid due date are counted by day. 'overdue' counts the pending tasks due before
+// 'today', and moving 'today' to a later day adds the counts of the days passed. Nothing here refers to a slot,
+// so sorting and compacting the list leave the counters alone.
+struct TaskStats {
+    uint64_t byPriority[2][PRIORITY_BUCKETS] = {};   // Tasks by status (1 if completed) and priority
+    uint64_t completed = 0;                          // Completed tasks
+    unordered_map<uint32_t, uint64_t> pendingByDay;  // Pending tasks by due day; days without any are left out
+    uint32_t today = 0;                              // Day 'overdue' is counted up to
+    uint64_t overdue = 0;                            // Pending tasks due before 'today'
+    bool built = false;                              // True while the counters cover the whole list
+};
+
+const uint32_t OVERDUE_REPORT_DAYS = 7;  // Days before today whose overdue tasks the statistics list one by one
+
 // Vector to store all tasks
-vector<Task> tasks;
+CowVector<Task> tasks;
+
+// Storage behind the task titles
+TitleArena titleArena;           // Titles imported from exchange files, and titles the pool cannot number
+TitlePool titlePool;             // Titles typed in, edited or replayed from the journal
+vector<MappedFile> mappedFiles;  // Task files whose contents the loaded titles point into
+vector<unique_ptr<char[]>> unpackedBlocks;  // Unpacked blocks of compressed task files, which hold their titles
+
+// Settings from the command line
+bool compressSnapshots = false;  // True if the task file is saved as a compressed container
+bool compressionChosen = false;  // True if --compress or --no-compress was given
+int autosaveSeconds = 0;         // Seconds between autosaves, or 0 to save only on reaching 'autosaveChanges'
+uint64_t autosaveChanges = 0;    // Unsaved changes that trigger an autosave, or 0 to save only on the interval
+vector<string> importFiles;      // Files named by --import, imported in order instead of showing the menu
+vector<string> exportFiles;      // Files named by --export, written after the imports
+uint64_t benchmarkAdds = 0;      // Tasks to add for --benchmark-add, or 0 to run normally
+uint64_t benchmarkSorts = 0;     // Tasks to sort for --benchmark-sort, or 0 to run normally
+uint64_t benchmarkSaves = 0;     // Tasks to save for --benchmark-save, or 0 to run normally
+uint64_t benchmarkFilters = 0;   // Tasks to filter for --benchmark-filter, or 0 to run normally
+
+// State of the autosave thread; every field here, 'tasks' and the task file state are guarded by 'tasksMutex'
+mutex tasksMutex;                     // Held by the menu while a command works on the list and by the autosave thread while it takes a snapshot
+unique_lock<mutex> menuLock(tasksMutex, defer_lock);  // The menu's hold on 'tasksMutex', let go while it waits for input
+condition_variable_any autosaveWake;  // Signalled when an autosave is due or the thread should stop
+condition_variable_any saveFinished;  // Signalled whenever a save has finished
+thread autosaveThread;                // Runs autosaveLoop while autosave is enabled or once a compaction has been requested
+bool autosaveStopping = false;        // True once the thread should exit
+bool saveInProgress = false;          // True between prepareSave and finishSave
+bool saveRequested = false;           // True if the journal has grown past JOURNAL_COMPACTION_BYTES
+bool compactRequested = false;        // True if the dead slots have passed TOMBSTONE_COMPACTION_RATIO
+uint64_t unsavedChanges = 0;          // Changes to the loaded list made since the last save was prepared
+
+// State of the journal
+uint64_t lastJournalSeq = 0;  // Sequence number of the last change applied to 'tasks'
+string journalName = JOURNAL_FILE;  // Name of the journal records are appended to; it changes at every save
+bool oldJournalKept = false;  // True while an old journal holds changes that no shard index covers yet
+
+// Struct to represent a wait for the user's input, during which the menu lets go of the list
+// A command holds 'menuLock' while it works on the list. Holding it while the user types would hold up the
+// autosave thread for as long as the user takes, so every read lets it go and takes it back once the input is in.
+// A background compaction may move tasks to new slots meanwhile, so a command that keeps a task across a prompt
+// keeps its ID rather than its slot.
+struct InputWait {
+    bool held;  // True if the menu held the lock when the wait began
+
+    InputWait() : held(menuLock.owns_lock()) {
+        if (held) menuLock.unlock();
+    }
+    ~InputWait() {
+        if (held) menuLock.lock();
+    }
+};
+
+// State of the task files
+ShardStore shardStore;        // Shards on disk and the place of every task in them
+TitleIndex titleIndex;        // Position of every title, once a lookup has needed it
+DueDateIndex dueDateIndex;    // Tasks in due date order, once a query has needed it
+PriorityIndex priorityIndex;  // Tasks by priority, once a query has needed it
+TaskColumns taskColumns;      // Filtered fields of the tasks, once a filter has needed them
+Tombstones tombstones;        // Slots of deleted tasks, until the list is compacted
+TaskIdMap taskIds;            // Slot of every task ID, once an ID has been needed
+TrigramIndex trigramIndex;    // Tasks by the pieces of their titles, once a search has needed it
+TitleTrie titleTrie;          // Titles in byte order, once a completion or suggestion has needed them
+vector<SortedView> sortedViews;  // Orders the list has been shown in, oldest choice first
+size_t activeView = LIST_ORDER;  // View viewTasks shows, or LIST_ORDER
+TaskStats taskStats;             // Counters over the tasks, once the progress or statistics have been shown
+ofstream journalFile;         // Journal opened for appending once the startup replay is done
+ofstream spareJournal;        // Empty journal under the other name, which the next save switches to
 
 // Function prototypes
 void displayMenu();                               // Displays the menu options to the user
-void addTask(vector<Task>& tasks);                // Adds a new task to the list
-void editTask(vector<Task>& tasks);               // Edits an existing task
-void deleteTask(vector<Task>& tasks);             // Deletes a task from the list
-void markTaskCompleted(vector<Task>& tasks);      // Marks a task as completed
-void viewTasks(const vector<Task>& tasks);        // Displays all tasks to the user
-void saveTasksToFile(const vector<Task>& tasks);  // Saves all tasks to a file
-void loadTasksFromFile(vector<Task>& tasks);      // Loads tasks from a file
-void filterAndSortTasks(vector<Task>& tasks);     // Filters and sorts tasks based on certain criteria
-bool isValidDate(const string& date);             // Validates the format of a date string
-
-int main() {
+void addTask(CowVector<Task>& tasks);                // Adds a new task to the list
+void editTask(CowVector<Task>& tasks);               // Edits an existing task
+void deleteTask(CowVector<Task>& tasks);             // Deletes a task from the list
+void markTaskCompleted(CowVector<Task>& tasks);      // Marks a task as completed
+void viewTasks(CowVector<Task>& tasks);              // Displays all tasks to the user
+void printTaskRow(const CowVector<Task>& tasks, size_t position);  // Displays one task as a list row
+void printTaskLine(const Task& task, uint64_t number, const string& id);  // Displays a task with its number and ID
+void saveTasksToFile(CowVector<Task>& tasks);        // Saves all tasks to a file
+size_t countTasks(const CowVector<Task>& tasks);     // Returns the number of tasks, loaded or not
+void prepareSave(CowVector<Task>& tasks, SaveJob& job);  // Takes a snapshot of the list and claims the changes to save
+bool runSave(SaveJob& job);                       // Writes a prepared save to disk
+void finishSave(SaveJob& job, bool written);      // Applies the outcome of a save to the task file state
+void autosaveLoop();                              // Body of the autosave thread
+void compactInBackground(unique_lock<mutex>& lock);  // Compacts the list on the autosave thread
+void startAutosave();                             // Starts the autosave thread if autosave is enabled
+void requestCompaction();                         // Hands the compaction of the list to the autosave thread
+void stopAutosave();                              // Stops the autosave thread, letting a running save finish
+bool rewriteShard(Shard& shard, SaveJob& job, uint64_t generation);  // Writes a fresh binary task file for a shard
+bool updateShardInPlace(Shard& shard, const SaveJob& job);  // Writes only the changed tasks into a shard's file
+bool writeCompressedShard(Shard& shard, SaveJob& job, uint64_t generation);  // Writes a compressed task file for a shard
+ShardIndexEntry shardIndexEntry(const Shard& shard);  // Describes a shard for the shard index
+BinaryLayout binaryLayout(uint64_t capacity, uint32_t version);  // Computes the column offsets for a given capacity
+void markTaskDirty(size_t index, uint8_t flags);  // Records that a task differs from its shard's file
+void placeTaskInShard(const CowVector<Task>& tasks, size_t index);  // Adds a task to the shard of its due month
+void removeTaskFromShard(size_t index);           // Takes a task out of its shard
+void compactShards(const vector<uint32_t>& order);  // Moves the shards over to the compacted list
+void regroupShards(const CowVector<Task>& tasks);    // Groups the whole list into shards afresh
+uint32_t dueMonth(uint32_t dueDay);               // Returns the YYYYMM month of a due day, or 0
+string shardFileName(uint32_t month, uint64_t generation);  // Returns the path of a shard file
+bool loadShardIndex();                            // Reads the list of shards
+bool writeShardIndex(vector<ShardIndexEntry>& entries, const vector<vector<uint32_t>>& deadRows, const SaveJob& job);  // Writes the list of shards
+void ensureTasksLoaded(CowVector<Task>& tasks);      // Reads every shard the first time the whole list is needed
+TitleLookup lookUpTitleInShards(string_view title);  // Checks a title against the shards without loading them
+bool readTitleBloom(Shard& shard);                // Reads the title bloom filter of a shard file
+uint64_t hashTitle(string_view title);            // Hashes a title for the title bloom filters and the title index
+bool titleTaken(CowVector<Task>& tasks, const TaskTitle& title);  // Checks whether a task already has a title
+size_t findTaskByTitle(CowVector<Task>& tasks, const TaskTitle& title);  // Returns the position of the task with a title
+void ensureTitleIndex(const CowVector<Task>& tasks);  // Builds the title index if it is not built yet
+void reserveTitleIndex(const CowVector<Task>& tasks, size_t count);  // Makes room in the title index for 'count' titles
+size_t findTitle(const CowVector<Task>& tasks, const TaskTitle& title, uint64_t hash);  // Looks a title up in the title index
+void indexTitle(const CowVector<Task>& tasks, size_t position, uint64_t hash);  // Adds a task's title to the title index
+void unindexTitle(const CowVector<Task>& tasks, size_t position);  // Removes a task's title from the title index
+void prefetchTitleSlot(uint64_t hash);            // Starts loading the title index slot a hash starts at
+uint32_t civilDay(int year, int month, int day);  // Returns the day number of a calendar date
+uint32_t dayNumber(string_view dueDate);          // Returns the day number of a YYYY-MM-DD date
+void formatDay(uint32_t day, char* out);          // Writes a day number as YYYY-MM-DD
+string dayText(uint32_t day);                     // Returns a day number as YYYY-MM-DD
+uint32_t today();                                 // Returns today's day number
+uint8_t clampPriority(int64_t priority);          // Brings a priority read from a file into range
+void ensureDueDateIndex(const CowVector<Task>& tasks);  // Builds the due date index if it is not built yet
+void indexDueDate(const CowVector<Task>& tasks, size_t position, uint32_t key);  // Adds a task to the due date index
+bool isCurrentDueEntry(const CowVector<Task>& tasks, uint64_t entry);  // Checks that a due date index entry still describes its task
+void findDueTasks(const CowVector<Task>& tasks, uint32_t first, uint32_t last, bool pendingOnly, size_t limit, vector<size_t>& out);  // Lists the tasks due in a range of dates
+bool listDueTasksInShards(uint32_t first, uint32_t last, bool pendingOnly, size_t limit);  // Lists tasks due in a range from the shards of those months
+void ensurePriorityIndex(const CowVector<Task>& tasks);  // Builds the priority index if it is not built yet
+void indexPriority(size_t position, uint8_t priority, bool completed);  // Adds a task to the priority index
+void unindexPriority(size_t position, uint8_t priority, bool completed);  // Removes a task from the priority index
+size_t highestPendingTask();                      // Returns the position of the first pending task of the highest priority
+const vector<uint32_t>& orderedPriorityBucket(int status, size_t bucketNumber);  // Sorts a priority bucket if it is out of order
+void findTasksByPriority(int minPriority, bool pendingOnly, vector<size_t>& out);  // Lists the tasks at or above a priority
+void ensureTaskColumns(const CowVector<Task>& tasks);  // Builds the task columns if they are not built yet
+void storeTaskColumns(size_t position, const Task& task);  // Copies a task's filtered fields into the columns
+void clearTaskColumns(size_t position);           // Marks a dead slot in the columns
+size_t countCompleted(const vector<uint64_t>* selection);  // Counts the completed tasks, of all or of a selection
+BitCounter chooseBitCounter();                    // Returns the fastest bit counter the processor runs
+size_t countBitsPortable(const uint64_t* words, const uint64_t* mask, size_t count);  // Bit counter in plain C++
+#ifdef USE_AVX2
+size_t countBitsPopcnt(const uint64_t* words, const uint64_t* mask, size_t count);  // Bit counter using the POPCNT instruction
+#endif
+uint64_t completionMask(const TaskFilter& filter, uint64_t completed);  // Selects the tasks of 64 whose status a filter allows
+void filterTasks(const TaskFilter& filter, vector<uint64_t>& selection);  // Marks the tasks a filter matches
+FilterKernel chooseFilterKernel();                // Returns the fastest filter kernel the processor runs
+void filterBlocksScalar(const uint32_t* dueDays, const uint8_t* priorities, const uint64_t* completed, size_t count, const TaskFilter& filter, uint64_t* selection);  // Filter kernel in plain C++
+#ifdef USE_SSE2
+void filterBlocksSse2(const uint32_t* dueDays, const uint8_t* priorities, const uint64_t* completed, size_t count, const TaskFilter& filter, uint64_t* selection);  // Filter kernel using SSE2
+#endif
+#ifdef USE_AVX2
+void filterBlocksAvx2(const uint32_t* dueDays, const uint8_t* priorities, const uint64_t* completed, size_t count, const TaskFilter& filter, uint64_t* selection);  // Filter kernel using AVX2
+#endif
+bool compileQuery(string_view text, TaskQuery& query, string& error);  // Parses a filter query into a flat program
+bool parseQueryOr(QueryParser& parser, bool negate);    // Compiles the terms of a query joined by 'or'
+bool parseQueryAnd(QueryParser& parser, bool negate);   // Compiles the terms of a query joined by 'and'
+bool parseQueryTerm(QueryParser& parser, bool negate);  // Compiles one comparison, status word, 'not' or parenthesized query
+string_view peekQueryToken(const QueryParser& parser, size_t& end);  // Returns the next token of a query without taking it
+string_view nextQueryToken(QueryParser& parser);  // Takes the next token of a query
+void emitQueryRange(TaskQuery& query, bool isDue, int64_t first, int64_t last);  // Adds a test of a due day or priority range
+void emitQueryTest(TaskQuery& query, const TaskFilter& test);  // Adds a range test to a query
+void emitQueryStep(TaskQuery& query, QueryOp op);  // Adds an AND or OR to a query, folding an AND of two tests into one
+void runQuery(const TaskQuery& query, vector<uint64_t>& selection);  // Marks the tasks a compiled query matches
+void answerFromIndex(const TaskFilter& test, size_t count, vector<uint64_t>& bits);  // Answers a range test from an index if one narrows it down
+bool matchesFilter(const TaskFilter& filter, size_t position);  // Tests one task of the columns against a filter
+void addTitleToBloom(vector<uint8_t>& bloom, string_view title, vector<size_t>* touched);  // Adds a title to a bloom filter
+bool bloomMayContain(const vector<uint8_t>& bloom, uint64_t hash);  // Tests a title's hash against a bloom filter
+bool readTaskFile(const string& fileName, TaskFileContents& contents);  // Reads a task file of any version
+bool readCompressedTaskFile(const string& fileName, MappedFile& file, TaskFileContents& contents);  // Reads a compressed task file
+void keepTitleStorage(TaskFileContents& contents);  // Keeps the memory behind a file's titles for the rest of the run
+void lzCompress(const char* data, size_t size, vector<char>& out);        // Compresses a block of bytes
+bool lzDecompress(const char* data, size_t size, char* out, size_t outSize);  // Unpacks a block made by lzCompress
+void runInParallel(size_t count, const function<void(size_t)>& body);     // Runs body(0) to body(count - 1) on all cores
+void parseCommandLine(int argc, char* argv[]);    // Reads the program options
+void benchmarkAddTasks(uint64_t count);           // Times adding many tasks the way addTask does
+void benchmarkSortTasks(uint64_t count);          // Times the radix sort against the exchange sort
+void benchmarkFilterTasks(uint64_t count);        // Times the filter kernels on generated columns
+void benchmarkSaveTasks(uint64_t count);          // Times saving generated tasks against the old text writer
+void loadTasksFromFile(CowVector<Task>& tasks);      // Loads tasks from a file
+bool loadTasksFromBinaryFile(CowVector<Task>& tasks, const string& fileName);  // Imports tasks from the single binary task file
+void loadTasksFromTextFile(CowVector<Task>& tasks, const string& fileName);    // Imports tasks from the legacy text file
+void parseTextRecords(const char* data, size_t size, size_t begin, size_t end, uint64_t lineIndex, vector<Task>& out);  // Parses the text records starting in a byte range
+void importTasks(CowVector<Task>& tasks, const string& fileName);  // Adds the tasks of a CSV or NDJSON file
+void exportTasks(CowVector<Task>& tasks, const string& fileName);  // Writes all tasks to a CSV or NDJSON file
+bool exchangeFormat(const string& fileName, ExchangeFormat& format);  // Picks the exchange format from a file name
+bool readCsvHeader(const char* data, size_t size, size_t& position, CsvColumns& columns);  // Reads the column names of a CSV file
+void parseCsvRecords(const char* data, size_t size, size_t begin, size_t end, uint8_t state, const CsvColumns& columns, ImportBatch& batch);  // Parses the CSV records starting in a byte range
+uint8_t nextCsvState(uint8_t state, char byte);   // Returns the CSV scan state after one more byte
+void scanCsvStates(const char* data, size_t begin, size_t end, uint8_t* states);  // Follows a byte range from every CSV scan state
+void parseJsonRecords(const char* data, size_t size, size_t begin, size_t end, bool atRecord, ImportBatch& batch);  // Parses the NDJSON records starting in a byte range
+bool splitCsvRecord(const char* data, size_t size, size_t& position, vector<string_view>& fields, TitleArena& arena);  // Splits one CSV record into fields
+const char* parseJsonObject(const char* position, const char* end, ImportFields& fields, TitleArena& arena);  // Reads the fields of one JSON object
+bool parseJsonString(const char*& position, const char* end, string_view& value, TitleArena& arena);  // Reads one JSON string
+const char* buildImportedTask(const ImportFields& fields, TitleArena& arena, Task& task);  // Validates a record and turns it into a task
+void addImportProblem(ImportBatch& batch, size_t offset, const char* reason);  // Counts a rejected record
+void appendCsvTask(const Task& task, string& out);   // Formats a task as a CSV record
+void appendJsonTask(const Task& task, string& out);  // Formats a task as an NDJSON line
+const char* findAnyOf(const char* position, const char* end, char a, char b, char c, char d);  // Finds the first of four bytes
+size_t countByte(const char* position, const char* end, char byte);  // Counts one byte value in a range
+bool mapFile(const string& fileName, MappedFile& file);  // Maps a whole file into memory for reading
+void unmapFile(MappedFile& file);                        // Releases a file mapped by mapFile
+TaskTitle storeTitle(string_view title);                 // Copies a title into the title pool unless a copy let go is there
+TaskTitle lookUpPooledTitle(string_view title);          // Returns the copy of a title the title pool holds, if any
+void poolTitle(const TaskTitle& title);                  // Lets the title pool reuse the copy of a title no task holds
+string_view storeTitle(TitleArena& arena, string_view title);  // Copies a title into a given title arena
+bool writeFileAtomically(const string& fileName, const char* data, size_t size);  // Replaces a file without ever leaving it half-written
+bool patchFile(const string& fileName, const vector<FilePatch>& patches, const FilePatch& commit);  // Updates parts of a file in place
+void commitOperation(CowVector<Task>& tasks, JournalRecord& record);        // Applies a change and appends it to the journal
+void appendTask(CowVector<Task>& tasks, Task task, uint64_t titleHash);      // Appends a task and keeps its shard and indexes up to date
+void applyJournalRecord(CowVector<Task>& tasks, const JournalRecord& record);  // Applies a change to the list in memory
+bool isDeadSlot(size_t slot);                     // Checks whether a slot holds a deleted task
+size_t slotOfTask(size_t index);                  // Returns the slot of the live task with the given index
+size_t taskIndex(size_t slot);                    // Returns the index of the live task in a slot
+void buryTask(size_t slot, size_t slotCount);     // Marks a slot dead
+void addLiveSlot(size_t slot);                    // Marks a slot appended to the list live
+void compactTasks(CowVector<Task>& tasks);        // Drops the dead slots from the list
+CowVector<Task> liveTasks(const CowVector<Task>& tasks, const vector<uint64_t>& live);  // Copies the live tasks of a list
+void installCompactedTasks(CowVector<Task>& tasks, CowVector<Task> compacted);  // Replaces the list with its compacted copy
+void ensureTaskIds(const CowVector<Task>& tasks);  // Builds the task ID map if it is not built yet
+void ensureTrigramIndex(const CowVector<Task>& tasks);  // Builds the trigram index if it is not built yet
+void indexTrigrams(const CowVector<Task>& tasks, size_t position);  // Adds a task's title to the trigram index
+void retireTrigrams(const CowVector<Task>& tasks, size_t position);  // Counts the trigram entries of a task's old title as stale
+uint32_t trigramBucket(const char* bytes);        // Returns the posting list of the trigram starting at 'bytes'
+void searchTitles(const CowVector<Task>& tasks, string_view text, vector<size_t>& out);  // Lists the tasks whose titles contain a text
+bool titleContains(string_view title, string_view text);  // Checks whether a title contains a text, ignoring ASCII case
+void ensureTitleTrie(const CowVector<Task>& tasks);  // Builds the title trie if it is not built yet
+void addTitleToTrie(const CowVector<Task>& tasks, size_t position);  // Adds a task's title to the title trie
+void removeTitleFromTrie(const CowVector<Task>& tasks, size_t position);  // Removes a task's title from the title trie
+uint32_t newTrieNode(string_view label, size_t slot);  // Returns a free trie node holding a label and a slot
+void splitTrieNode(uint32_t node, size_t length);  // Cuts a trie node's label after 'length' bytes
+void mergeTrieNode(uint32_t node);                // Merges a trie node with its only child
+uint32_t findTrieChild(uint32_t node, char byte, uint32_t& previous);  // Finds the child of a trie node starting with a byte
+void completeTitle(string_view prefix, size_t limit, vector<size_t>& out);  // Lists the tasks whose titles start with a prefix
+void suggestTitles(string_view text, size_t maxDistance, size_t except, size_t limit, vector<size_t>& out);  // Lists the tasks with titles close to a text
+string readTitle(CowVector<Task>& tasks, const char* prompt);  // Reads a title, listing completions on request
+void showSimilarTitles(CowVector<Task>& tasks, string_view title, size_t except);  // Tells the user about titles close to a new one
+void selectSortedView(const uint8_t* fields);     // Makes the view ordered by some sort fields the one viewTasks shows
+void ensureSortedView(const CowVector<Task>& tasks, SortedView& view);  // Builds a view if it is not built yet
+void addToSortedViews(const CowVector<Task>& tasks, size_t position);  // Enters a task's current fields in the built views
+bool isCurrentViewEntry(const CowVector<Task>& tasks, const SortedView& view, uint64_t entry);  // Checks that a view entry still describes its task
+void listSortedView(const CowVector<Task>& tasks, SortedView& view, vector<size_t>& out);  // Lists the live tasks in a view's order
+string sortFieldsText(const uint8_t* fields);     // Describes sort fields in words
+void ensureTaskStats(const CowVector<Task>& tasks);  // Builds the task counters if they are not built yet
+void addToStats(const Task& task);                // Counts a task in the task counters
+void removeFromStats(const Task& task);           // Takes a task out of the task counters
+void advanceStatsDay();                           // Moves the overdue count up to today
+void showTaskStats(CowVector<Task>& tasks);       // Reports the task counters
+void assignTaskId(size_t slot);                   // Hands out an ID to a task appended to the list
+void releaseTaskId(size_t slot);                  // Retires the ID of a deleted task
+void moveTaskIds(const vector<uint32_t>& order);  // Follows the tasks to their slots after a sort or compaction
+uint64_t taskId(size_t slot);                     // Returns the ID of the task in a slot
+string taskIdText(size_t slot);                   // Returns the ID of the task in a slot as the menu shows it
+size_t slotOfTaskId(uint64_t id);                 // Returns the slot of the task with an ID
+size_t readTaskSlot(CowVector<Task>& tasks);      // Reads a task number or ID and returns the task's slot
+void encodeJournalRecord(const JournalRecord& record, vector<char>& out);   // Serializes a journal record
+size_t decodeJournalRecord(const char* data, size_t size, JournalRecord& record);  // Parses one journal record
+void replayJournal(CowVector<Task>& tasks);       // Re-applies the changes logged since the last save
+void replayJournalFile(CowVector<Task>& tasks, const string& fileName, uint64_t& count, size_t& replayed);  // Re-applies the records of one journal file
+void openJournal();                               // Opens the journal for appending, creating it if needed
+void openSpareJournal(ofstream& file, const string& fileName);  // Creates an empty journal for a save to switch to
+uint64_t firstJournalSeq(const string& fileName);  // Returns the sequence number a journal file starts at
+void compactJournal(CowVector<Task>& tasks);         // Writes the changed shards and empties the journal
+void sortTasks(CowVector<Task>& tasks, SortKey key, const uint8_t* fields, vector<uint32_t>& order); // Sorts the list in the given order
+uint64_t packSortKey(const Task& task, const uint8_t* fields);  // Packs the sort fields of a task into one integer
+void radixSortOrder(vector<uint64_t>& keys, vector<uint32_t>& order);  // Sorts positions by their packed keys
+void reorderTasks(CowVector<Task>& tasks, const vector<uint32_t>& order);  // Rearranges the list into a given order
+bool parseSortFields(string_view text, uint8_t* fields);  // Reads sort fields typed as letters
+void filterAndSortTasks(CowVector<Task>& tasks);     // Filters and sorts tasks based on certain criteria
+bool isValidDate(string_view date);               // Validates the format of a date string
+bool isValidPriority(int priority);               // Checks that a priority lies in the range 1 to 100
+bool readLine(string& line);                      // Reads a line of input, letting go of the list meanwhile
+template <typename T> bool readNumber(T& value);  // Reads a number from the input, letting go of the list meanwhile
+
+int main(int argc, char* argv[]) {
 
     // Precondition: The program should have access to the required file for loading tasks.
     // Post condition: All tasks will be saved back to the file before exiting the program.
 
+    parseCommandLine(argc, argv);  // Read options such as --compress
+    if (benchmarkAdds > 0) {
+        benchmarkAddTasks(benchmarkAdds);  // Runs on a scratch list and leaves the real one alone
+        return 0;
+    }
+    if (benchmarkSorts > 0) {
+        benchmarkSortTasks(benchmarkSorts);  // Sorts generated tasks in memory only
+        return 0;
+    }
+    if (benchmarkFilters > 0) {
+        benchmarkFilterTasks(benchmarkFilters);  // Filters generated columns in memory only
+        return 0;
+    }
+    if (benchmarkSaves > 0) {
+        benchmarkSaveTasks(benchmarkSaves);  // Runs on a scratch list and leaves the real one alone
+        return 0;
+    }
     loadTasksFromFile(tasks);  // Load tasks from file at the start of the program
 
+    // Bulk imports and exports run without the menu, so scheduled syncs can call the program directly
+    if (!importFiles.empty() || !exportFiles.empty()) {
+        {
+            lock_guard<mutex> lock(tasksMutex);
+            for (const string& fileName : importFiles) importTasks(tasks, fileName);
+            for (const string& fileName : exportFiles) exportTasks(tasks, fileName);
+        }
+        stopAutosave();  // A compaction the imports asked for finishes first
+        return 0;
+    }
+    startAutosave();  // Save in the background if --autosave or --autosave-changes was given
+
     int choice;
     do {
+        menuLock.lock();  // The autosave thread only takes a snapshot while no command works on the list
         displayMenu();  // Display the menu options to the user
+        menuLock.unlock();
         cout << "Enter your choice: " << endl;
 
         if (!(cin >> choice)) {
@@ -49,7 +1064,8 @@ int main() {
 
         cin.ignore();  // Ignore the newline character after the number input
 
-        // Process the user's choice
+        // Process the user's choice; the command lets go of the list whenever it waits for input
+        menuLock.lock();
         switch (choice) {
             case 1: addTask(tasks); break;                     // Add a new task
             case 2: deleteTask(tasks); break;                  // Delete an existing task
@@ -61,11 +1077,328 @@ int main() {
             case 8: cout << "Exiting program..." << endl; break;  // Exit the program
             default: cout << "Invalid choice. Please select a valid option." << endl;  // Handle invalid choice
         }
+        menuLock.unlock();
     } while (choice != 8);
+    stopAutosave();  // Let a save in progress finish before exiting
     return 0;
 }
 
 
+// Function to read the program options
+void parseCommandLine(int argc, char* argv[]) {
+    // Precondition: 'argv' holds 'argc' arguments as passed to main.
+    // Post condition: The settings named on the command line are applied; unknown options are reported and ignored.
+
+    for (int i = 1; i < argc; ++i) {
+        string option = argv[i];
+        if (option == "--compress" || option == "--no-compress") {
+            compressSnapshots = option == "--compress";  // Save tasks.bin as a compressed container, or not
+            compressionChosen = true;
+        } else if (option.rfind("--autosave=", 0) == 0 || option.rfind("--autosave-changes=", 0) == 0) {
+            // Save in the background every SECONDS, or after COUNT changes
+            bool byTime = option[10] == '=';
+            const char* first = option.data() + option.find('=') + 1;
+            const char* last = option.data() + option.size();
+            uint64_t value = 0;
+            auto [end, error] = from_chars(first, last, value);
+            if (error != errc() || end != last || first == last || (byTime && value > INT_MAX)) {
+                cout << "Invalid value in " << option << " ignored." << endl;
+            } else if (byTime) {
+                autosaveSeconds = static_cast<int>(value);
+            } else {
+                autosaveChanges = value;
+            }
+        } else if (option.rfind("--benchmark-add=", 0) == 0 || option.rfind("--benchmark-sort=", 0) == 0 ||
+                   option.rfind("--benchmark-filter=", 0) == 0 || option.rfind("--benchmark-save=", 0) == 0) {
+            // Time adding COUNT tasks to an empty list in a scratch directory, or sorting, filtering or saving COUNT
+            // generated tasks
+            uint64_t& count = option[12] == 'a' ? benchmarkAdds : option[12] == 'f' ? benchmarkFilters
+                            : option[13] == 'o' ? benchmarkSorts : benchmarkSaves;
+            const char* first = option.data() + option.find('=') + 1;
+            const char* last = option.data() + option.size();
+            auto [end, error] = from_chars(first, last, count);
+            if (error != errc() || end != last || count > UINT32_MAX) {
+                cout << "Invalid value in " << option << " ignored." << endl;
+                count = 0;
+            }
+        } else if (option.rfind("--import=", 0) == 0) {
+            importFiles.push_back(option.substr(9));  // Add the tasks of a .csv or .ndjson file
+        } else if (option.rfind("--export=", 0) == 0) {
+            exportFiles.push_back(option.substr(9));  // Write all tasks to a .csv or .ndjson file
+        } else {
+            cout << "Unknown option " << option << " ignored. Options: --compress, --no-compress, "
+                 << "--autosave=SECONDS, --autosave-changes=COUNT, --import=FILE, --export=FILE, --benchmark-add=COUNT, "
+                 << "--benchmark-sort=COUNT, --benchmark-filter=COUNT, --benchmark-save=COUNT" << endl;
+        }
+    }
+}
+
+
+// Function to time adding many tasks the way addTask does
+void benchmarkAddTasks(uint64_t count) {
+    // Precondition: The list has not been loaded.
+    // Post condition: 'count' generated tasks were added to an empty list in a scratch directory, with the duplicate
+    //                 check and journaling of addTask, and the time taken is reported. The scratch directory is
+    //                 removed again, so the real task files are never touched.
+
+    error_code error;
+    filesystem::path home = filesystem::current_path();
+    filesystem::path scratch = filesystem::temp_directory_path(error) / ("todo-benchmark-" + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+    if (error || !filesystem::create_directory(scratch, error)) {
+        cout << "Could not create a scratch directory for the benchmark." << endl;
+        return;
+    }
+    filesystem::current_path(scratch);
+    lock_guard<mutex> lock(tasksMutex);  // compactJournal expects it, as it does from the menu
+    loadTasksFromFile(tasks);
+
+    // Titles are all different and due dates are spread over a year, as in a real list
+    chrono::steady_clock::duration checking{};
+    auto started = chrono::steady_clock::now();
+    char dueDate[16];
+    for (uint64_t i = 0; i < count; ++i) {
+        string typed = "Benchmark task " + to_string(i);
+        TaskTitle title = lookUpPooledTitle(typed);  // Checked before it is copied, as in addTask
+        auto checkStarted = chrono::steady_clock::now();
+        bool taken = titleTaken(tasks, title);
+        checking += chrono::steady_clock::now() - checkStarted;
+        if (taken) {
+            cout << "Benchmark title " << title << " was reported as taken." << endl;
+            break;
+        }
+
+        snprintf(dueDate, sizeof(dueDate), "2026-%02d-%02d", static_cast<int>(i % 12) + 1, static_cast<int>(i % 28) + 1);
+        JournalRecord record;
+        record.op = JOURNAL_ADD;
+        record.task.title = storeTitle(typed);
+        record.task.dueDay = dayNumber(dueDate);
+        record.task.priority = static_cast<uint8_t>(i % 100 + 1);
+        record.task.completed = false;
+        commitOperation(tasks, record);
+    }
+    auto total = chrono::steady_clock::now() - started;
+
+    using chrono::duration_cast;
+    using chrono::milliseconds;
+    using chrono::nanoseconds;
+    cout << "Added " << tasks.size() << " tasks in " << duration_cast<milliseconds>(total).count() << " ms, "
+         << duration_cast<milliseconds>(checking).count() << " ms of it checking titles ("
+         << duration_cast<nanoseconds>(checking).count() / max<uint64_t>(count, 1) << " ns per task)." << endl;
+
+    journalFile.close();
+    spareJournal.close();
+    filesystem::current_path(home);
+    filesystem::remove_all(scratch, error);
+}
+
+
+// Function to time the radix sort against the exchange sort it replaced
+void benchmarkSortTasks(uint64_t count) {
+    // Precondition: None
+    // Post condition: 'count' generated tasks were sorted in memory by several orders and the times are reported.
+    //                 The exchange sort takes quadratic time, so it is timed on at most EXCHANGE_BENCHMARK_TASKS
+    //                 of them. No file is read or written.
+
+    CowVector<Task> generated;
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    char dueDate[16];
+    for (uint64_t i = 0; i < count; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        uint32_t random = static_cast<uint32_t>(state >> 32);
+        snprintf(dueDate, sizeof(dueDate), "2026-%02d-%02d", static_cast<int>(random % 12) + 1, static_cast<int>(random / 12 % 28) + 1);
+        Task task;
+        task.title = storeTitle(titleArena, "Benchmark task " + to_string(i));  // Plain copies, as an import makes
+        task.dueDay = dayNumber(dueDate);
+        task.priority = static_cast<uint8_t>(random / 336 % 100 + 1);
+        task.completed = random / 33600 % 4 == 0;
+        generated.push_back(move(task));
+    }
+
+    using chrono::duration_cast;
+    using chrono::microseconds;
+    auto timeSort = [&](const char* name, SortKey key, const uint8_t* fields, size_t taskCount) {
+        CowVector<Task> list;
+        for (size_t i = 0; i < taskCount; ++i) list.push_back(generated[i]);
+        auto started = chrono::steady_clock::now();
+        vector<uint32_t> order;
+        sortTasks(list, key, fields, order);
+        auto taken = duration_cast<microseconds>(chrono::steady_clock::now() - started).count();
+        cout << name << " of " << taskCount << " tasks: " << taken / 1000.0 << " ms" << endl;
+    };
+    uint8_t multiKey[MAX_SORT_FIELDS] = {SORT_FIELD_PRIORITY | SORT_DESCENDING, SORT_FIELD_DUE_DATE, SORT_FIELD_STATUS};
+    timeSort("Radix sort by priority", SORT_BY_PRIORITY, nullptr, count);
+    timeSort("Radix sort by due date", SORT_BY_DUE_DATE, nullptr, count);
+    timeSort("Radix sort by priority (descending), due date and status", SORT_BY_FIELDS, multiKey, count);
+    size_t exchangeCount = min<uint64_t>(count, EXCHANGE_BENCHMARK_TASKS);
+    timeSort("Radix sort by priority", SORT_BY_PRIORITY, nullptr, exchangeCount);
+    timeSort("Exchange sort by priority", SORT_BY_PRIORITY_EXCHANGE, nullptr, exchangeCount);
+    timeSort("Exchange sort by due date", SORT_BY_DUE_DATE_EXCHANGE, nullptr, exchangeCount);
+}
+
+
+// Function to time saving against the text writer the program started with
+void benchmarkSaveTasks(uint64_t count) {
+    // Precondition: The list has not been loaded.
+    // Post condition: 'count' generated tasks were saved in a scratch directory, once by the old text writer, once
+    //                 as a full save of every shard and once more after 1% of them changed, and the times and write
+    //                 speeds are reported. The scratch directory is removed again, so the real task files are
+    //                 never touched.
+
+    error_code error;
+    filesystem::path home = filesystem::current_path();
+    filesystem::path scratch = filesystem::temp_directory_path(error) / ("todo-benchmark-" + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+    if (error || !filesystem::create_directory(scratch, error)) {
+        cout << "Could not create a scratch directory for the benchmark." << endl;
+        return;
+    }
+    filesystem::current_path(scratch);
+    lock_guard<mutex> lock(tasksMutex);  // compactJournal expects it, as it does from the menu
+    loadTasksFromFile(tasks);
+
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    char dueDate[16];
+    for (uint64_t i = 0; i < count; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        uint32_t random = static_cast<uint32_t>(state >> 32);
+        snprintf(dueDate, sizeof(dueDate), "2026-%02d-%02d", static_cast<int>(random % 12) + 1, static_cast<int>(random / 12 % 28) + 1);
+        Task task;
+        task.title = storeTitle(titleArena, "Benchmark task " + to_string(i));
+        task.dueDay = dayNumber(dueDate);
+        task.priority = static_cast<uint8_t>(random / 336 % 100 + 1);
+        task.completed = random / 33600 % 4 == 0;
+        uint64_t titleHash = hashTitle(task.title);
+        appendTask(tasks, move(task), titleHash);
+    }
+    unsavedChanges = count;
+
+    auto directoryBytes = [](const filesystem::path& directory) {
+        error_code ignored;
+        uint64_t bytes = 0;
+        for (const auto& entry : filesystem::directory_iterator(directory, ignored)) bytes += entry.file_size(ignored);
+        return bytes;
+    };
+    auto report = [](const char* name, chrono::steady_clock::duration taken, uint64_t bytes) {
+        double seconds = chrono::duration<double>(taken).count();
+        cout << name << ": " << seconds * 1000 << " ms, " << bytes / 1e6 << " MB, " << bytes / 1e6 / max(seconds, 1e-9) << " MB/s" << endl;
+    };
+
+    // The writer the program started with: one line per field, each flushed by endl
+    auto started = chrono::steady_clock::now();
+    {
+        ofstream outFile("tasks.txt");
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            outFile << tasks[i].title << endl
+                    << dayText(tasks[i].dueDay) << endl
+                    << int(tasks[i].priority) << endl
+                    << tasks[i].completed << endl;
+        }
+    }
+    report("Text writer (tasks.txt)", chrono::steady_clock::now() - started, filesystem::file_size("tasks.txt", error));
+    filesystem::remove("tasks.txt", error);
+
+    // Every shard is new, so this writes them all, each through writeFileAtomically
+    started = chrono::steady_clock::now();
+    compactJournal(tasks);
+    report("Full save (tasks.shards)", chrono::steady_clock::now() - started, directoryBytes(SHARD_DIRECTORY));
+
+    // Change a hundred tasks, then one task in a hundred, and save again; only those tasks are written, in place
+    for (uint64_t stride : {max<uint64_t>(count / 100, 1), uint64_t(100)}) {
+        uint64_t changed = 0;
+        for (size_t position = 0; position < tasks.size(); position += stride) {
+            JournalRecord record;
+            record.op = JOURNAL_EDIT;
+            record.index = position;
+            record.task = tasks[position];
+            record.task.priority = static_cast<uint8_t>(record.task.priority % MAX_PRIORITY + 1);
+            commitOperation(tasks, record);
+            ++changed;
+        }
+        started = chrono::steady_clock::now();
+        compactJournal(tasks);
+        auto taken = chrono::steady_clock::now() - started;
+        cout << "Save after changing " << changed << " tasks: " << chrono::duration<double, milli>(taken).count() << " ms" << endl;
+    }
+
+    journalFile.close();
+    spareJournal.close();
+    filesystem::current_path(home);
+    filesystem::remove_all(scratch, error);
+}
+
+
+// Function to time the filter kernels
+void benchmarkFilterTasks(uint64_t count) {
+    // Precondition: The list has not been loaded.
+    // Post condition: The task columns were filled with 'count' generated tasks and filtered by every kernel this
+    //                 build and processor can run, on one thread and through filterTasks, and the completed tasks
+    //                 counted; the speeds are reported. No file is read or written.
+
+    taskColumns.dueDays.resize(count);
+    taskColumns.priorities.resize(count);
+    taskColumns.completed.assign((count + 63) / 64, 0);
+    taskColumns.built = true;
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    uint32_t firstDay = dayNumber("2026-01-01");
+    for (uint64_t i = 0; i < count; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        uint32_t random = static_cast<uint32_t>(state >> 32);
+        taskColumns.dueDays[i] = firstDay + random % 365;
+        taskColumns.priorities[i] = static_cast<uint8_t>(random / 365 % 100 + 1);
+        if (random / 36500 % 4 == 0) taskColumns.completed[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    // Pending tasks of priority 50 to 80 due in the second quarter of the year, about one task in ten
+    TaskFilter filter;
+    filter.firstDay = dayNumber("2026-04-01");
+    filter.lastDay = dayNumber("2026-06-30");
+    filter.minPriority = 50;
+    filter.maxPriority = 80;
+    filter.maxCompleted = 0;
+
+    vector<pair<const char*, FilterKernel>> kernels = {{"Plain", filterBlocksScalar}};
+#ifdef USE_SSE2
+    kernels.push_back({"SSE2", filterBlocksSse2});
+#endif
+#ifdef USE_AVX2
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"AVX2", filterBlocksAvx2});
+#endif
+    vector<uint64_t> selection((count + 63) / 64);
+    double bytes = static_cast<double>(count) * (sizeof(uint32_t) + 1) + taskColumns.completed.size() * sizeof(uint64_t);
+    auto report = [&](const string& name, const function<void()>& run) {
+        // The best of five runs, so a page fault or a busy moment does not count
+        double best = 1e30;
+        for (int round = 0; round < 5; ++round) {
+            auto started = chrono::steady_clock::now();
+            run();
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - started).count());
+        }
+        size_t matches = 0;
+        for (uint64_t word : selection) matches += popcount(word);
+        cout << name << ": " << best * 1000 << " ms, " << bytes / best / 1e9 << " GB/s, " << matches << " matches" << endl;
+    };
+    for (const auto& [name, kernel] : kernels) {
+        report(string(name) + " kernel on one thread", [&, kernel = kernel] {
+            kernel(taskColumns.dueDays.data(), taskColumns.priorities.data(), taskColumns.completed.data(), count, filter, selection.data());
+        });
+    }
+    report("filterTasks", [&] { filterTasks(filter, selection); });
+
+    // Progress of the whole list and of the tasks the filter selects when it allows either status, as the menu shows it
+    filter.maxCompleted = 1;
+    filterTasks(filter, selection);
+    size_t completedCount = 0;
+    size_t selectedCompleted = 0;
+    auto started = chrono::steady_clock::now();
+    for (int round = 0; round < 100; ++round) {
+        completedCount += countCompleted(nullptr);
+        selectedCompleted += countCompleted(&selection);
+    }
+    double taken = chrono::duration<double, micro>(chrono::steady_clock::now() - started).count() / 200;
+    cout << "Counting completed tasks: " << taken << " us per count, " << completedCount / 100 << " in all, "
+         << selectedCompleted / 100 << " selected" << endl;
+}
+
+
 // Function to display the menu options to the user
 void displayMenu() {
 
@@ -81,19 +1414,31 @@ void displayMenu() {
     cout << "6. Filter and Sort Tasks" << endl;
     cout << "7. Save Tasks to File" << endl;
     cout << "8. Exit" << endl;
-    cout << "You have " << tasks.size() << (tasks.size() == 1 ? " task" : " tasks") << endl;
+    size_t count = countTasks(tasks);  // Taken from the shard index until the shards are loaded
+    cout << "You have " << count << (count == 1 ? " task" : " tasks");
+    if (shardStore.loaded && count > 0) {
+        // Read from the task counters, so the progress costs the same for any list size
+        ensureTaskStats(tasks);
+        advanceStatsDay();
+        cout << ", " << taskStats.completed << " completed (" << taskStats.completed * 100 / count << "%)";
+        if (taskStats.overdue > 0) cout << ", " << taskStats.overdue << " overdue";
+    }
+    cout << endl;
 }
 
 // Function to validate the format of a date string (expected format: YYYY-MM-DD)
-bool isValidDate(const string& date) {
+bool isValidDate(string_view date) {
 
-    // Precondition: The date string must be in the format YYYY-MM-DD.
-    // Post condition: Returns true if the date is valid, otherwise returns false.
+    // Precondition: None
+    // Post condition: Returns true if the date is a real date in the format YYYY-MM-DD, otherwise returns false.
 
     if (date.size() != 10 || date[4] != '-' || date[7] != '-') return false;
-    int year = stoi(date.substr(0, 4));
-    int month = stoi(date.substr(5, 2));
-    int day = stoi(date.substr(8, 2));
+    for (size_t i : {0, 1, 2, 3, 5, 6, 8, 9}) {
+        if (date[i] < '0' || date[i] > '9') return false;  // Signs and spaces would slip through a plain number parse
+    }
+    int year = (date[0] - '0') * 1000 + (date[1] - '0') * 100 + (date[2] - '0') * 10 + (date[3] - '0');
+    int month = (date[5] - '0') * 10 + (date[6] - '0');
+    int day = (date[8] - '0') * 10 + (date[9] - '0');
 
     if (month < 1 || month > 12 || day < 1 || day > 31) return false;
     if ((month == 4 || month == 6 || month == 9 || month == 11) && day > 30) return false;
@@ -107,247 +1452,5545 @@ bool isValidDate(const string& date) {
 }
 
 
+// Function to validate a priority level
+bool isValidPriority(int priority) {
+    // Precondition: None
+    // Post condition: Returns true if the priority lies in the range 1 to 100, otherwise returns false.
+
+    return priority >= MIN_PRIORITY && priority <= MAX_PRIORITY;
+}
+
+
+// Function to read a line of input
+bool readLine(string& line) {
+    // Precondition: None
+    // Post condition: 'line' holds the next line typed and true is returned, or false once the input has ended.
+    //                 The menu's hold on the list is let go while the user types.
+
+    InputWait wait;
+    return static_cast<bool>(getline(cin, line));
+}
+
+
+// Function to read a number from the input
+template <typename T>
+bool readNumber(T& value) {
+    // Precondition: None
+    // Post condition: 'value' holds the number typed and true is returned, or false with the error flag of 'cin'
+    //                 set. The menu's hold on the list is let go while the user types.
+
+    InputWait wait;
+    return static_cast<bool>(cin >> value);
+}
+
+
 // Function to add a new task to the list
-void addTask(vector<Task>& tasks) {
+void addTask(CowVector<Task>& tasks) {
     Task newTask;
 
     // Precondition: The 'tasks' vector must be accessible and modifiable.
     // Post condition: A new task is added to the 'tasks' vector if it meets all validation criteria.
 
-    // Prompt for task title
-    cout << "Enter task title: " << endl;
-    getline(cin, newTask.title);
+    // Prompt for task title; ending it with a tab lists the titles it starts first
+    string title = readTitle(tasks, "Enter task title (end with Tab to list matching titles): ");
 
-    // Check for duplicate task titles
-    for (const auto& task : tasks) {
-        if (task.title == newTask.title) {
-            cout << "A task with this title already exists." << endl;
-            return;
-        }
+    // Check for duplicate task titles. A title a deleted task let go comes back with its handle, which the check
+    // compares before any bytes; the title is only copied once it is accepted, since 'title' goes away on return
+    TaskTitle typed = lookUpPooledTitle(title);
+    if (titleTaken(tasks, typed)) {
+        cout << "A task with this title already exists." << endl;
+        return;
     }
+    newTask.title = typed.handle != NO_TITLE_HANDLE ? typed : storeTitle(title);
+    showSimilarTitles(tasks, newTask.title, NO_TASK);  // Catches a typo that would make a near duplicate
 
     // Prompt for valid due date until a valid date is provided
+    string dueDate;
     do {
         cout << "Enter due date (YYYY-MM-DD): " << endl;
-        getline(cin, newTask.dueDate);
-        if (!isValidDate(newTask.dueDate)) {
+        readLine(dueDate);
+        if (!isValidDate(dueDate)) {
             cout << "Invalid date. Ensure the format is YYYY-MM-DD." << endl;
         }
-    } while (!isValidDate(newTask.dueDate));
+    } while (!isValidDate(dueDate));
+    newTask.dueDay = dayNumber(dueDate);
 
     // Prompt for valid priority (1-100) until a valid priority is provided
+    int priority;
     cout << "Enter priority (1-100): " << endl;
-    while (!(cin >> newTask.priority) || newTask.priority < 1 || newTask.priority > 100) {
+    while (!readNumber(priority) || !isValidPriority(priority)) {
         cin.clear();  // Clear the error flag on cin
         cin.ignore(10000, '\n');  // Ignore invalid input
         cout << "Invalid priority. Please enter a number between 1 and 100: " << endl;
     }
     cin.ignore();  // Ignore the newline character after the number input
+    newTask.priority = static_cast<uint8_t>(priority);
 
     newTask.completed = false;  // Initialize task as not completed
-    tasks.push_back(newTask);  // Add the new task to the vector
+
+    JournalRecord record;
+    record.op = JOURNAL_ADD;
+    record.task = newTask;
+    commitOperation(tasks, record);  // Add the new task to the vector and log it
     cout << "Task added successfully." << endl;
 }
 
 
 // Function to edit an existing task in the list
-void editTask(vector<Task>& tasks) {
-    int index;
-
+void editTask(CowVector<Task>& tasks) {
     // Precondition: The 'tasks' vector must be accessible and modifiable.
-    // Post condition: The specified task is updated with new details if the index is valid.
+    // Post condition: The specified task is updated with new details if the number or ID is valid.
 
-    // Prompt for task number to edit
-    cout << "Enter task number to edit: " << endl;
-    cin >> index;
-    cin.ignore();  // Ignore the newline character after the number input
+    // Prompt for task number or ID to edit
+    cout << "Enter task number or #ID to edit: " << endl;
+    size_t slot = readTaskSlot(tasks);
 
-    // Check if the index is valid
-    if (index > 0 && index <= tasks.size()) {
-        Task& task = tasks[index - 1];  // Access the task to be edited
+    if (slot != NO_TASK) {
+        Task task = tasks[slot];  // Copy the task to be edited
         cout << "Editing Task: " << task.title << endl;
 
-        // Prompt for new title
-        cout << "Enter new title: " << endl;
-        getline(cin, task.title);
+        // The task is kept by its ID, since a compaction may move it while the user types
+        ensureTaskIds(tasks);
+        uint64_t id = taskId(slot);
+
+        // Prompt for new title; a new title's copy replaces the task's view rather than being written over the old title
+        string title = readTitle(tasks, "Enter new title (end with Tab to list matching titles): ");
+        slot = slotOfTaskId(id);
+        TaskTitle typed = lookUpPooledTitle(title);
+        size_t holder = findTaskByTitle(tasks, typed);
+        if (holder != NO_TASK && holder != slot) {
+            cout << "A task with this title already exists." << endl;  // Keeping the task's own title is fine
+            return;
+        }
+        if (holder != slot) task.title = typed.handle != NO_TITLE_HANDLE ? typed : storeTitle(title);  // A kept title keeps its copy
+        showSimilarTitles(tasks, task.title, slot);
 
         // Prompt for valid new due date until a valid date is provided
+        string dueDate;
         do {
             cout << "Enter new due date (YYYY-MM-DD): " << endl;
-            getline(cin, task.dueDate);
-        } while (!isValidDate(task.dueDate));
+            readLine(dueDate);
+        } while (!isValidDate(dueDate));
+        task.dueDay = dayNumber(dueDate);
 
         // Prompt for valid new priority (1-100) until a valid priority is provided
+        int priority;
         cout << "Enter new priority (1-100): " << endl;
-        while (!(cin >> task.priority) || task.priority < 1 || task.priority > 100) {
+        while (!readNumber(priority) || !isValidPriority(priority)) {
             cin.clear();  // Clear the error flag on cin
             cin.ignore(10000, '\n');  // Ignore invalid input
             cout << "Invalid priority. Try again: " << endl;
         }
         cin.ignore();  // Ignore the newline character after the number input
+        task.priority = static_cast<uint8_t>(priority);
 
+        JournalRecord record;
+        record.op = JOURNAL_EDIT;
+        record.index = taskIndex(slotOfTaskId(id));  // The journal numbers the live tasks
+        record.task = task;
+        commitOperation(tasks, record);  // Store the new details and log them
         cout << "Task updated successfully." << endl;
-    } else {
-        // Handle invalid task number
-        cout << "Invalid task number." << endl;
     }
 }
 
 // Function to delete a task from the list
-void deleteTask(vector<Task>& tasks) {
-    int index;
-
+void deleteTask(CowVector<Task>& tasks) {
     // Precondition: The 'tasks' vector must be accessible and modifiable.
-    // Post condition: The specified task is removed from the 'tasks' vector if the index is valid.
+    // Post condition: The specified task is removed from the list if the number or ID is valid.
 
-    // Prompt for task number to delete
-    cout << "Enter task number to delete: " << endl;
-    cin >> index;
-    cin.ignore();  // Ignore the newline character after the number input
+    // Prompt for task number or ID to delete
+    cout << "Enter task number or #ID to delete: " << endl;
+    size_t slot = readTaskSlot(tasks);
 
-    // Check if the index is valid
-    if (index > 0 && index <= tasks.size()) {
-        tasks.erase(tasks.begin() + index - 1);  // Remove the task from the vector
+    if (slot != NO_TASK) {
+        JournalRecord record;
+        record.op = JOURNAL_DELETE;
+        record.index = taskIndex(slot);
+        commitOperation(tasks, record);  // Mark the task's slot dead and log the delete
         cout << "Task deleted successfully." << endl;
-    } else {
-        // Handle invalid task number
-        cout << "Invalid task number." << endl;
     }
 }
 
 
 // Function to mark a task as completed in the list
-void markTaskCompleted(vector<Task>& tasks) {
-    int index;
-
+void markTaskCompleted(CowVector<Task>& tasks) {
     // Precondition: The 'tasks' vector must be accessible and modifiable.
-    // Post condition: The specified task's 'completed' status is set to true if the index is valid.
+    // Post condition: The specified task's 'completed' status is set to true if the number or ID is valid.
 
-    // Prompt for task number to mark as completed
-    cout << "Enter task number to mark as completed: " << endl;
-    cin >> index;
-    cin.ignore();  // Ignore the newline character after the number input
+    // Prompt for task number or ID to mark as completed
+    cout << "Enter task number or #ID to mark as completed: " << endl;
+    size_t slot = readTaskSlot(tasks);
 
-    // Check if the index is valid
-    if (index > 0 && index <= tasks.size()) {
-        tasks[index - 1].completed = true;  // Mark the task as completed
+    if (slot != NO_TASK) {
+        JournalRecord record;
+        record.op = JOURNAL_COMPLETE;
+        record.index = taskIndex(slot);
+        commitOperation(tasks, record);  // Mark the task as completed and log it
         cout << "Task marked as completed." << endl;
-    } else {
-        // Handle invalid task number
-        cout << "Invalid task number." << endl;
     }
 }
 
 
 // Function to display all tasks in the list
-void viewTasks(const vector<Task>& tasks) {
+void viewTasks(CowVector<Task>& tasks) {
     // Precondition: The 'tasks' vector must be accessible and its elements must be readable.
     // Post condition: All tasks and their details are displayed to the user. The completion percentage is also displayed.
 
-    cout << endl << "--- Task List ---" << endl;
-    int completedCount = 0;
+    ensureTasksLoaded(tasks);  // The shards are read the first time the list is needed
+    ensureTaskIds(tasks);
 
-    // Iterate through all tasks and display their details
-    for (size_t i = 0; i < tasks.size(); ++i) {
-        const Task& task = tasks[i];
-        cout << i + 1 << ". " << task.title << " | Due: " << task.dueDate
-             << " | Priority: " << task.priority
-             << " | Status: " << (task.completed ? "Completed" : "Pending") << endl;
-        if (task.completed) ++completedCount;  // Count completed tasks
+    // Iterate through all tasks and display their details; dead slots take no number
+    size_t number = 0;
+    if (activeView == LIST_ORDER) {
+        cout << endl << "--- Task List ---" << endl;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            if (isDeadSlot(i)) continue;
+            printTaskRow(tasks, i);
+            ++number;
+        }
+    } else {
+        // The chosen view is already in order; each task keeps the number that commands take
+        SortedView& view = sortedViews[activeView];
+        cout << endl << "--- Task List by " << sortFieldsText(view.fields) << " ---" << endl;
+        vector<size_t> order;
+        listSortedView(tasks, view, order);
+        for (size_t position : order) printTaskRow(tasks, position);
+        number = order.size();
     }
 
-    // Calculate and display the completion percentage
-    if (tasks.empty()) {
+    // Calculate and display the completion percentage from the task counters
+    if (number == 0) {
         cout << "Completion Percentage: 0%" << endl;
     } else {
-        int completionPercentage = (completedCount * 100) / tasks.size();
+        ensureTaskStats(tasks);
+        size_t completionPercentage = (taskStats.completed * 100) / number;
         cout << "Completion Percentage: " << completionPercentage << "%" << endl;
     }
 }
 
 
-// Function to save all tasks to a file
-void saveTasksToFile(const vector<Task>& tasks) {
-    // Precondition: The 'tasks' vector must be accessible and its elements must be readable.
-    // Post condition: All tasks in the 'tasks' vector are written to a file named "tasks.txt".
+// Function to show one task as the lists show it
+void printTaskRow(const CowVector<Task>& tasks, size_t position) {
+    // Precondition: 'position' is a live slot of 'tasks' and the task ID map is built.
+    // Post condition: The task's number, title, due date, priority, status and ID are displayed on one line.
 
-    ofstream outFile("tasks.txt");  // Open the file for writing
+    printTaskLine(tasks[position], taskIndex(position) + 1, taskIdText(position));
+}
+
+
+// Function to show a task as the lists show it, given its number and ID
+void printTaskLine(const Task& task, uint64_t number, const string& id) {
+    // Precondition: None
+    // Post condition: The number, title, due date, priority, status and ID are displayed on one line.
+
+    cout << number << ". " << task.title << " | Due: " << dayText(task.dueDay) << " | Priority: " << int(task.priority)
+         << " | Status: " << (task.completed ? "Completed" : "Pending") << " | ID: " << id << endl;
+}
+
+
+// Function to save all tasks to the shard files
+void saveTasksToFile(CowVector<Task>& tasks) {
+    // Precondition: The 'tasks' vector must be accessible and its elements must be readable.
+    // Post condition: All tasks are written to the shard files in "tasks.shards" and the journal is emptied.
+
+    // Every change is already in the journal, so saving just folds the journal into the shards
+    compactJournal(tasks);
+    cout << "Tasks saved successfully." << endl;  // Inform the user that tasks have been saved
+}
+
+
+// Function to return the number of tasks, whether or not the shards are loaded
+size_t countTasks(const CowVector<Task>& tasks) {
+    // Precondition: None
+    // Post condition: Returns the size of the whole list, including changes not yet applied to loaded shards and
+    //                 leaving out dead slots.
+
+    return shardStore.loaded ? tasks.size() - tombstones.deadCount : shardStore.taskCount;
+}
+
+
+// Function to prepare a save: take a snapshot of the list and claim the changes to be written
+void prepareSave(CowVector<Task>& tasks, SaveJob& job) {
+    // Precondition: The shards are loaded, 'tasksMutex' is held and no other save is in progress.
+    // Post condition: 'job' holds everything runSave needs, so the list may change while it runs. New records go to
+    //                 the spare journal, since the snapshot covers every record in the current one.
+
+    // Deleted tasks stay in their files as dead rows, listed in the index, and sorts regroup the shards as they
+    // happen, so only a format switch touches every shard here
+    if (shardStore.compressed != compressSnapshots) {
+        for (Shard& shard : shardStore.shards) shard.rewrite = true;
+    }
+
+    job.tasks = tasks;  // Copies only the chunk pointers
+    job.journalSeq = lastJournalSeq;
+    job.changes = unsavedChanges;
+    job.compressed = compressSnapshots;
+    job.retiredFiles = move(shardStore.retiredFiles);
+    shardStore.retiredFiles.clear();
+    unsavedChanges = 0;
+    saveRequested = false;
+    saveInProgress = true;
+
+    // Copy out the shards with changes and hand their changes to the job; later changes are tracked afresh
+    for (uint32_t s = 0; s < shardStore.shards.size(); ++s) {
+        Shard& shard = shardStore.shards[s];
+        if (!shard.rewrite && shard.file.dirtyTasks.empty()) {
+            if (shard.generation == 0) continue;
+            job.unchanged.push_back(shardIndexEntry(shard));
+            job.unchangedDeadRows.push_back(shard.deadRows);  // A delete only changes the index
+            continue;
+        }
+        if (shard.members.empty()) {
+            // The last task of the month has gone, so the shard's file is dropped with the next index
+            if (shard.generation != 0) job.retiredFiles.push_back(shardFileName(shard.month, shard.generation));
+            shard.generation = 0;
+            shard.storedCount = 0;
+            shard.rewrite = false;
+            shard.file = SnapshotState();
+            continue;
+        }
+        job.shardNumbers.push_back(s);
+        job.shards.push_back(shard);
+        job.generations.push_back(shardStore.nextGeneration++);
+        shard.rewrite = false;
+        shard.file.dirtyFlags.clear();
+        shard.file.dirtyTasks.clear();
+        shard.file.garbageBytes = 0;
+    }
+    job.nextGeneration = shardStore.nextGeneration;
+
+    // Switch to the spare journal, which was opened ahead, and leave runSave to move the covered one aside. If an
+    // earlier save failed, its old journal is still needed, so the current journal simply carries on
+    if (!oldJournalKept && spareJournal.is_open()) {
+        job.journal = move(journalFile);
+        job.journalName = journalName;
+        journalFile = move(spareJournal);
+        journalName = job.journalName == JOURNAL_FILE ? JOURNAL_NEXT_FILE : JOURNAL_FILE;
+    }
+}
+
+
+// Function to write a prepared save to disk
+bool runSave(SaveJob& job) {
+    // Precondition: 'job' was filled in by prepareSave. Only 'job' is used, so this may run without 'tasksMutex'.
+    // Post condition: Returns true if the shard index on disk now covers the job's snapshot.
+
+    error_code error;
+    filesystem::create_directories(SHARD_DIRECTORY, error);
+
+    // Move the journal the snapshot covers aside, to be deleted once the new index covers it, and open an empty one
+    // under its name for the next save to switch to
+    if (!job.journalName.empty()) {
+        job.journal.close();
+        filesystem::rename(job.journalName, JOURNAL_OLD_FILE, error);
+        if (error) return false;
+        openSpareJournal(job.spareJournal, job.journalName);
+    }
+
+    // Write each shard in place when its file allows it, otherwise as a new file
+    vector<ShardIndexEntry> entries = job.unchanged;
+    vector<vector<uint32_t>> deadRows = job.unchangedDeadRows;
+    for (size_t i = 0; i < job.shards.size(); ++i) {
+        Shard& shard = job.shards[i];
+        bool written = !shard.rewrite && updateShardInPlace(shard, job);
+        if (!written) written = job.compressed ? writeCompressedShard(shard, job, job.generations[i]) : rewriteShard(shard, job, job.generations[i]);
+        if (!written) return false;
+        entries.push_back(shardIndexEntry(shard));
+        deadRows.push_back(shard.deadRows);  // Every file keeps its dead rows in their slots
+    }
+
+    // The index is the commit point: until it is replaced, a load sees the previous files and dead rows and replays
+    // the journal on top
+    if (!writeShardIndex(entries, deadRows, job)) return false;
+    for (const string& fileName : job.retiredFiles) filesystem::remove(fileName, error);
+    job.retiredFiles.clear();
+    filesystem::remove(JOURNAL_OLD_FILE, error);
+    return true;
+}
+
+
+// Function to apply the outcome of a save to the task file state
+void finishSave(SaveJob& job, bool written) {
+    // Precondition: 'tasksMutex' is held and 'job' has been through runSave, which returned 'written'.
+    // Post condition: The shards describe their new files or, if the save failed, are due to be written again.
+
+    for (size_t i = 0; i < job.shards.size(); ++i) {
+        Shard& shard = shardStore.shards[job.shardNumbers[i]];
+        Shard& saved = job.shards[i];
+        if (!written) {
+            shard.rewrite = true;  // The claimed changes still have to reach the disk
+            continue;
+        }
+
+        // Keep the changes made while the save was running; they go into the next one
+        SnapshotState file = move(saved.file);
+        file.garbageBytes += shard.file.garbageBytes;
+        file.dirtyFlags = move(shard.file.dirtyFlags);
+        file.dirtyTasks = move(shard.file.dirtyTasks);
+        shard.file = move(file);
+        shard.generation = saved.generation;
+        shard.storedCount = saved.storedCount;
+        shard.bloomOffset = saved.bloomOffset;
+        shard.bloomBytes = saved.bloomBytes;
+        shard.titleBloom = move(saved.titleBloom);
+    }
+
+    if (job.spareJournal.is_open()) spareJournal = move(job.spareJournal);
+    if (written) oldJournalKept = false;
+    else if (!job.journalName.empty()) oldJournalKept = true;  // The moved journal holds changes no index covers
+
+    if (written) {
+        shardStore.compressed = job.compressed;
+    } else {
+        cout << "Failed to save tasks to " << SHARD_DIRECTORY << "." << endl;
+        unsavedChanges += job.changes;
+        for (string& fileName : job.retiredFiles) shardStore.retiredFiles.push_back(move(fileName));
+    }
+    saveInProgress = false;
+    saveFinished.notify_all();
+}
+
+
+// Function run by the autosave thread
+void autosaveLoop() {
+    // Precondition: Autosave is enabled or a compaction was requested, and this thread does not hold 'tasksMutex'.
+    // Post condition: Returns once 'autosaveStopping' is set. Until then, a save is written whenever the interval
+    //                 passes with changes unsaved, the change threshold is reached or the journal grows too large,
+    //                 and the list is compacted whenever commitOperation asks for it.
+
+    unique_lock<mutex> lock(tasksMutex);
+    auto saveDue = [] { return saveRequested || (autosaveChanges > 0 && unsavedChanges >= autosaveChanges); };
+    auto due = [&] { return autosaveStopping || compactRequested || saveDue(); };
+    while (!autosaveStopping) {
+        bool timedOut = false;
+        if (autosaveSeconds > 0) timedOut = !autosaveWake.wait_for(lock, chrono::seconds(autosaveSeconds), due);
+        else autosaveWake.wait(lock, due);
+        if (compactRequested && !autosaveStopping) {
+            compactInBackground(lock);
+            if (!timedOut && !saveDue()) continue;  // Only the compaction was due
+        }
+        if (autosaveStopping || unsavedChanges == 0 || saveInProgress || !shardStore.loaded) continue;
+
+        // Only the snapshot is taken under the lock; the menu keeps working while the files are written
+        SaveJob job;
+        prepareSave(tasks, job);
+        lock.unlock();
+        bool written = runSave(job);
+        lock.lock();
+        finishSave(job, written);
+    }
+}
+
+
+// Function to compact the list on the autosave thread
+void compactInBackground(unique_lock<mutex>& lock) {
+    // Precondition: 'lock' holds 'tasksMutex' and this is the autosave thread.
+    // Post condition: No slot is dead. 'lock' holds 'tasksMutex' again, but was let go while the live tasks were copied.
+
+    // Like a save, only the snapshot is taken under the lock, so the menu keeps working while the tasks are copied
+    compactRequested = false;
+    CowVector<Task> snapshot = tasks;
+    vector<uint64_t> live = tombstones.live;
+    size_t deadCount = tombstones.deadCount;
+    uint64_t journalSeq = lastJournalSeq;
+    lock.unlock();
+    CowVector<Task> compacted = liveTasks(snapshot, live);
+    lock.lock();
+
+    // A change made in the meantime leaves the copy out of date, so the list is then compacted under the lock
+    bool unchanged = lastJournalSeq == journalSeq && tombstones.deadCount == deadCount && tasks.size() == snapshot.size();
+    if (unchanged && deadCount > 0) installCompactedTasks(tasks, move(compacted));
+    else compactTasks(tasks);
+}
+
+
+// Function to start the autosave thread
+void startAutosave() {
+    // Precondition: The tasks have been loaded and the thread is not running.
+    // Post condition: The thread is running if --autosave or --autosave-changes was given.
+
+    if (autosaveSeconds > 0 || autosaveChanges > 0) autosaveThread = thread(autosaveLoop);
+}
+
+
+// Function to hand the compaction of the list to the autosave thread
+void requestCompaction() {
+    // Precondition: 'tasksMutex' is held.
+    // Post condition: The autosave thread, started now if autosave is off, compacts the list once it gets the lock.
+
+    // Without autosave the thread only ever compacts, plus any save the journal's size asks for
+    if (!autosaveThread.joinable()) autosaveThread = thread(autosaveLoop);
+    compactRequested = true;
+    autosaveWake.notify_all();
+}
+
+
+// Function to stop the autosave thread
+void stopAutosave() {
+    // Precondition: This thread does not hold 'tasksMutex'.
+    // Post condition: The thread has exited; a save it was writing has been finished first.
+
+    if (!autosaveThread.joinable()) return;
+    {
+        lock_guard<mutex> lock(tasksMutex);
+        autosaveStopping = true;
+    }
+    autosaveWake.notify_all();
+    autosaveThread.join();
+}
+
+
+// Function to write a fresh binary task file holding all tasks of a shard
+bool rewriteShard(Shard& shard, SaveJob& job, uint64_t generation) {
+    // Precondition: 'shard' is a copy, held by 'job', of a shard with at least one task.
+    // Post condition: Returns true if a new file numbered 'generation' was written; 'shard' then describes it and its
+    //                 old file is added to the job's retired files. The new file only counts once the index is written.
+
+    const CowVector<Task>& tasks = job.tasks;
+
+    // Leave spare slots in every column so that tasks added later can be saved in place
+    uint64_t count = shard.members.size();
+    uint64_t capacity = max(MIN_SNAPSHOT_CAPACITY, count + count / 2);
+    BinaryLayout layout = binaryLayout(capacity, BINARY_FILE_VERSION);
+
+    uint64_t titleBytes = 0;
+    for (uint32_t position : shard.members) titleBytes += tasks[position].title.size();
+    vector<char> buffer(layout.titleHeap + titleBytes);
+    vector<uint8_t> bloom(capacity, 0);
+
+    // Fill every column in one pass over the shard's tasks
+    uint64_t titleOffset = layout.titleHeap;
+    for (size_t i = 0; i < count; ++i) {
+        const Task& task = tasks[shard.members[i]];
+        TitleRef ref = {titleOffset, static_cast<uint32_t>(task.title.size()), 0};
+        int32_t priority = task.priority;
+        memcpy(&buffer[layout.titleRefs + i * sizeof(TitleRef)], &ref, sizeof(ref));
+        memcpy(&buffer[layout.priorities + i * sizeof(int32_t)], &priority, sizeof(priority));
+        buffer[layout.completion + i] = task.completed ? 1 : 0;
+        formatDay(task.dueDay, &buffer[layout.dueDates + i * DUE_DATE_LENGTH]);
+        memcpy(&buffer[layout.positions + i * sizeof(uint32_t)], &shard.members[i], sizeof(uint32_t));
+        memcpy(&buffer[titleOffset], task.title.data(), task.title.size());
+        addTitleToBloom(bloom, task.title, nullptr);
+        titleOffset += task.title.size();
+    }
+    memcpy(&buffer[layout.titleBloom], bloom.data(), bloom.size());
+
+    BinaryFileHeader header = {};
+    memcpy(header.magic, BINARY_FILE_MAGIC, sizeof(header.magic));
+    header.version = BINARY_FILE_VERSION;
+    header.taskCount = count;
+    header.capacity = capacity;
+    header.journalSeq = job.journalSeq;
+    header.titleHeapEnd = titleOffset;
+    memcpy(buffer.data(), &header, sizeof(header));
+
+    // Every rewrite goes to a file with a new name, so the file the current index lists stays intact until the index moves on
+    if (!writeFileAtomically(shardFileName(shard.month, generation), buffer.data(), buffer.size())) return false;
+    if (shard.generation != 0) job.retiredFiles.push_back(shardFileName(shard.month, shard.generation));
+
+    shard.generation = generation;
+    shard.storedCount = count;
+    shard.bloomOffset = layout.titleBloom;
+    shard.bloomBytes = capacity;
+    shard.titleBloom = move(bloom);
+    shard.rewrite = false;
+    shard.file = SnapshotState();
+    shard.file.updatable = true;
+    shard.file.taskCount = count;
+    shard.file.capacity = capacity;
+    shard.file.titleHeapEnd = titleOffset;
+    return true;
+}
+
+
+// Function to write only the changed tasks of a shard into its existing file
+bool updateShardInPlace(Shard& shard, const SaveJob& job) {
+    // Precondition: 'shard' is a copy, held by 'job', whose 'file' describes the shard's file and lists every slot
+    //               changed since it was written.
+    // Post condition: Returns true if the file was brought up to date in place. Returns false, leaving the
+    //                 file consistent, if it has to be rewritten instead.
+
+    // Only changes that leave every other task where it is can be written in place. Appended tasks stay
+    // invisible until the header and the shard index are updated, and overwritten tasks get the same values
+    // again if the journal is replayed after a crash. New titles are committed before any ref points at them,
+    // so the file is correct at every step
+    const CowVector<Task>& tasks = job.tasks;
+    SnapshotState& state = shard.file;
+    if (!state.updatable || shard.members.size() > state.capacity || shard.titleBloom.size() != state.capacity) return false;
+
+    // Once most of the title heap is dead space, a compact rewrite is the better deal
+    BinaryLayout layout = binaryLayout(state.capacity, BINARY_FILE_VERSION);
+    if (state.garbageBytes > state.titleHeapEnd - layout.titleHeap - state.garbageBytes) return false;
+    vector<uint32_t> dirty = state.dirtyTasks;
+    sort(dirty.begin(), dirty.end());
+
+    // Changed titles are appended to the title heap and added to the title filter
+    vector<FilePatch> titlePatches;
+    FilePatch heapPatch = {state.titleHeapEnd, {}};
+    vector<uint32_t> retitled;
+    vector<size_t> bloomBytes;
+    for (uint32_t slot : dirty) {
+        if (!(state.dirtyFlags[slot] & DIRTY_TITLE)) continue;
+        string_view title = tasks[shard.members[slot]].title;
+        retitled.push_back(slot);
+        heapPatch.bytes.insert(heapPatch.bytes.end(), title.begin(), title.end());
+        addTitleToBloom(shard.titleBloom, title, &bloomBytes);
+    }
+    uint64_t titleOffset = state.titleHeapEnd;
+    uint64_t heapEnd = state.titleHeapEnd + heapPatch.bytes.size();
+    uint64_t newTitleBytes = heapPatch.bytes.size();
+    if (!heapPatch.bytes.empty()) titlePatches.push_back(move(heapPatch));
+    sort(bloomBytes.begin(), bloomBytes.end());
+    bloomBytes.erase(unique(bloomBytes.begin(), bloomBytes.end()), bloomBytes.end());
+    for (size_t byte : bloomBytes) titlePatches.push_back({layout.titleBloom + byte, {static_cast<char>(shard.titleBloom[byte])}});
+
+    // Every run of consecutive changed slots becomes one write per column
+    vector<FilePatch> patches;
+    for (size_t start = 0, end = 0; start < dirty.size(); start = end) {
+        for (end = start + 1; end < dirty.size() && dirty[end] == dirty[end - 1] + 1;) ++end;
+        uint32_t first = dirty[start];
+        size_t length = end - start;
+        FilePatch priorities = {layout.priorities + first * sizeof(int32_t), vector<char>(length * sizeof(int32_t))};
+        FilePatch completion = {layout.completion + first, vector<char>(length)};
+        FilePatch dueDates = {layout.dueDates + first * DUE_DATE_LENGTH, vector<char>(length * DUE_DATE_LENGTH)};
+        FilePatch positions = {layout.positions + first * sizeof(uint32_t), vector<char>(length * sizeof(uint32_t))};
+        for (size_t i = 0; i < length; ++i) {
+            const Task& task = tasks[shard.members[first + i]];
+            int32_t priority = task.priority;
+            memcpy(&priorities.bytes[i * sizeof(int32_t)], &priority, sizeof(priority));
+            completion.bytes[i] = task.completed ? 1 : 0;
+            formatDay(task.dueDay, &dueDates.bytes[i * DUE_DATE_LENGTH]);
+            memcpy(&positions.bytes[i * sizeof(uint32_t)], &shard.members[first + i], sizeof(uint32_t));
+        }
+        patches.push_back(move(priorities));
+        patches.push_back(move(completion));
+        patches.push_back(move(dueDates));
+        patches.push_back(move(positions));
+    }
+    for (size_t start = 0, end = 0; start < retitled.size(); start = end) {
+        for (end = start + 1; end < retitled.size() && retitled[end] == retitled[end - 1] + 1;) ++end;
+        FilePatch refs = {layout.titleRefs + retitled[start] * sizeof(TitleRef), vector<char>((end - start) * sizeof(TitleRef))};
+        for (size_t i = start; i < end; ++i) {
+            TitleRef ref = {titleOffset, static_cast<uint32_t>(tasks[shard.members[retitled[i]]].title.size()), 0};
+            memcpy(&refs.bytes[(i - start) * sizeof(TitleRef)], &ref, sizeof(ref));
+            titleOffset += ref.length;
+        }
+        patches.push_back(move(refs));
+    }
+
+    auto headerPatch = [&](uint64_t taskCount, uint64_t garbageBytes) {
+        BinaryFileHeader header = {};
+        memcpy(header.magic, BINARY_FILE_MAGIC, sizeof(header.magic));
+        header.version = BINARY_FILE_VERSION;
+        header.taskCount = taskCount;
+        header.capacity = state.capacity;
+        header.journalSeq = job.journalSeq;
+        header.titleHeapEnd = heapEnd;
+        header.garbageBytes = garbageBytes;
+        FilePatch commit = {0, vector<char>(sizeof(header))};
+        memcpy(commit.bytes.data(), &header, sizeof(header));
+        return commit;
+    };
+    string fileName = shardFileName(shard.month, shard.generation);
+
+    // The new titles are committed first, by a header that only moves 'titleHeapEnd' and counts them as garbage
+    // while nothing refers to them. A crash after it leaves every ref inside the committed heap, so the file still
+    // loads; the journal then writes the titles again and the first copies stay counted as garbage
+    if (!titlePatches.empty() && !patchFile(fileName, titlePatches, headerPatch(state.taskCount, state.garbageBytes + newTitleBytes))) return false;
+
+    // The header goes last; together with the shard index it makes the new tasks visible
+    if (!patchFile(fileName, patches, headerPatch(shard.members.size(), state.garbageBytes))) return false;
+
+    state.taskCount = shard.members.size();
+    state.titleHeapEnd = heapEnd;
+    for (uint32_t slot : state.dirtyTasks) state.dirtyFlags[slot] = 0;
+    state.dirtyTasks.clear();
+    shard.storedCount = shard.members.size();
+    return true;
+}
+
+
+// Function to compute the column offsets of a binary task file with room for 'capacity' tasks
+BinaryLayout binaryLayout(uint64_t capacity, uint32_t version) {
+    // Precondition: 'version' is 2 or 3.
+    // Post condition: Returns the page-aligned start of every column and of the title heap. Version 2 files
+    //                 have no positions or title bloom; those columns are given an empty range.
+
+    auto pageAligned = [](uint64_t offset) { return (offset + FILE_PAGE_BYTES - 1) / FILE_PAGE_BYTES * FILE_PAGE_BYTES; };
+    BinaryLayout layout;
+    layout.titleRefs = FILE_PAGE_BYTES;
+    layout.priorities = pageAligned(layout.titleRefs + capacity * sizeof(TitleRef));
+    layout.completion = pageAligned(layout.priorities + capacity * sizeof(int32_t));
+    layout.dueDates = pageAligned(layout.completion + capacity);
+    layout.positions = pageAligned(layout.dueDates + capacity * DUE_DATE_LENGTH);
+    if (version < 3) {
+        layout.titleBloom = layout.positions;
+        layout.titleHeap = layout.positions;
+        return layout;
+    }
+    layout.titleBloom = pageAligned(layout.positions + capacity * sizeof(uint32_t));
+    layout.titleHeap = pageAligned(layout.titleBloom + capacity);
+    return layout;
+}
+
+
+// Function to record that a task differs from its copy in its shard's file
+void markTaskDirty(size_t index, uint8_t flags) {
+    // Precondition: 'index' is the position of an existing task that has been placed in a shard.
+    // Post condition: The task will be written by the next in-place update of the shard's file.
+
+    Shard& shard = shardStore.shards[shardStore.taskShard[index]];
+    if (shard.rewrite) return;         // The next save rewrites this shard anyway
+    SnapshotState& state = shard.file;
+    uint32_t slot = shardStore.taskSlot[index];
+    if (state.dirtyFlags.size() <= slot) state.dirtyFlags.resize(slot + 1, 0);
+    if (state.dirtyFlags[slot] == 0) state.dirtyTasks.push_back(slot);
+    state.dirtyFlags[slot] |= flags;
+}
+
+
+// Function to add a task to the shard of its due month
+void placeTaskInShard(const CowVector<Task>& tasks, size_t index) {
+    // Precondition: 'index' is the position of an existing task that is in no shard yet.
+    // Post condition: The task takes the next free slot of its shard, which is created for the month's first task.
+    //                 A dead slot's task is listed as a dead row.
+
+    uint32_t month = dueMonth(tasks[index].dueDay);
+    auto found = shardStore.shardOfMonth.find(month);
+    if (found == shardStore.shardOfMonth.end()) {
+        Shard shard;
+        shard.month = month;
+        shard.rewrite = true;  // A new shard has no file yet
+        shardStore.shards.push_back(move(shard));
+        found = shardStore.shardOfMonth.emplace(month, static_cast<uint32_t>(shardStore.shards.size() - 1)).first;
+    }
+
+    Shard& shard = shardStore.shards[found->second];
+    if (shardStore.taskShard.size() <= index) {
+        shardStore.taskShard.resize(index + 1);
+        shardStore.taskSlot.resize(index + 1);
+    }
+    shardStore.taskShard[index] = found->second;
+    shardStore.taskSlot[index] = static_cast<uint32_t>(shard.members.size());
+    if (isDeadSlot(index)) shard.deadRows.push_back(static_cast<uint32_t>(shard.members.size()));
+    shard.members.push_back(static_cast<uint32_t>(index));
+}
+
+
+// Function to take a task out of its shard
+void removeTaskFromShard(size_t index) {
+    // Precondition: 'index' is the position of a task that has been placed in a shard.
+    // Post condition: The task is no longer in the shard and the shard's file is due for a full rewrite.
+
+    Shard& shard = shardStore.shards[shardStore.taskShard[index]];
+    uint32_t slot = shardStore.taskSlot[index];
+    shard.members.erase(shard.members.begin() + slot);
+    for (uint32_t later = slot; later < shard.members.size(); ++later) shardStore.taskSlot[shard.members[later]] = later;
+    for (uint32_t& row : shard.deadRows) row -= row > slot;
+    shard.rewrite = true;  // The slots after the task have moved up
+}
+
+
+// Function to move the shards over to the compacted list
+void compactShards(const vector<uint32_t>& order) {
+    // Precondition: 'order' lists the live slots of the list in order; the shards still describe the list as it
+    //               was before compaction.
+    // Post condition: Every shard lists its live tasks at their new positions and no dead rows. Only the shards
+    //                 that lost a dead row or hold a task whose position changed are due for a full rewrite.
+
+    const uint32_t DROPPED = UINT32_MAX;
+    vector<uint32_t> newPosition(shardStore.taskShard.size(), DROPPED);
+    for (uint32_t position = 0; position < order.size(); ++position) newPosition[order[position]] = position;
+
+    // A file records the position of each of its tasks. Patching those in place could leave the files of a save
+    // cut short disagreeing about the order, while a rewritten file only counts once the index lists it
+    vector<uint32_t> taskShard(order.size());
+    vector<uint32_t> taskSlot(order.size());
+    for (uint32_t s = 0; s < shardStore.shards.size(); ++s) {
+        Shard& shard = shardStore.shards[s];
+        if (!shard.deadRows.empty()) {
+            erase_if(shard.members, [&](uint32_t position) { return newPosition[position] == DROPPED; });
+            shard.deadRows.clear();
+            shard.rewrite = true;
+        }
+        for (uint32_t slot = 0; slot < shard.members.size(); ++slot) {
+            uint32_t position = newPosition[shard.members[slot]];
+            if (position != shard.members[slot]) shard.rewrite = true;
+            shard.members[slot] = position;
+            taskShard[position] = s;
+            taskSlot[position] = slot;
+        }
+    }
+    shardStore.taskShard = move(taskShard);
+    shardStore.taskSlot = move(taskSlot);
+}
+
+
+// Function to group the whole list into shards afresh
+void regroupShards(const CowVector<Task>& tasks) {
+    // Precondition: No save is in progress, since its shards are found by their place in 'shardStore.shards'.
+    // Post condition: Every task is placed in the shard of its due month and every shard is due for a full
+    //                 rewrite; the files of the previous shards are retired.
+
+    for (const Shard& shard : shardStore.shards) {
+        if (shard.generation != 0) shardStore.retiredFiles.push_back(shardFileName(shard.month, shard.generation));
+    }
+    shardStore.shards.clear();
+    shardStore.shardOfMonth.clear();
+    shardStore.taskShard.clear();
+    shardStore.taskSlot.clear();
+    for (size_t i = 0; i < tasks.size(); ++i) placeTaskInShard(tasks, i);
+}
+
+
+// Function to return the month a due date falls in
+uint32_t dueMonth(uint32_t dueDay) {
+    // Precondition: None
+    // Post condition: Returns the month as YYYYMM, or 0 for NO_DUE_DAY.
+
+    if (dueDay == NO_DUE_DAY) return 0;
+    char date[DUE_DATE_LENGTH];
+    formatDay(dueDay, date);
+    uint32_t year = 0, month = 0;
+    from_chars(date, date + 4, year);
+    from_chars(date + 5, date + 7, month);
+    return year * 100 + month;
+}
+
+
+// Function to return the path of a shard file
+string shardFileName(uint32_t month, uint64_t generation) {
+    // Precondition: None
+    // Post condition: Returns a name such as "tasks.shards/2024-05.7.bin"; tasks without a readable month go to "undated".
+
+    char name[48];
+    if (month == 0) snprintf(name, sizeof(name), "undated.%llu.bin", static_cast<unsigned long long>(generation));
+    else snprintf(name, sizeof(name), "%04u-%02u.%llu.bin", month / 100, month % 100, static_cast<unsigned long long>(generation));
+    return SHARD_DIRECTORY + "/" + name;
+}
+
+
+// Function to read the shard index
+bool loadShardIndex() {
+    // Precondition: None
+    // Post condition: Returns true and describes every shard in 'shardStore' if "tasks.shards/index.bin" was read;
+    //                 no shard file is opened. Files in the directory that the index does not list are removed.
+
+    ifstream inFile(SHARD_INDEX_FILE, ios::binary);
+    if (!inFile) return false;  // No shards yet
+
+    // Check the header and the size of the entry list before reading the entries
+    ShardIndexHeader header = {};
+    error_code error;
+    uint64_t fileSize = filesystem::file_size(SHARD_INDEX_FILE, error);
+    inFile.read(reinterpret_cast<char*>(&header), sizeof(header));
+    // Version 1 indexes list no dead rows
+    uint64_t entryBytes = sizeof(header) + uint64_t(header.shardCount) * sizeof(ShardIndexEntry);
+    bool valid = inFile && !error && memcmp(header.magic, SHARD_INDEX_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version >= 1 && header.version <= SHARD_INDEX_VERSION && fileSize >= entryBytes;
+    vector<ShardIndexEntry> entries(valid ? header.shardCount : 0);
+    inFile.read(reinterpret_cast<char*>(entries.data()), static_cast<streamsize>(entries.size() * sizeof(ShardIndexEntry)));
+    valid = valid && inFile;
+
+    uint64_t total = 0;
+    uint64_t deadTotal = 0;
+    unordered_map<uint32_t, uint32_t> shardOfMonth;
+    for (size_t i = 0; valid && i < entries.size(); ++i) {
+        const ShardIndexEntry& entry = entries[i];
+        valid = entry.generation != 0 && entry.generation < header.nextGeneration && entry.taskCount > 0 &&
+                entry.deadCount <= entry.taskCount && (header.version > 1 || entry.deadCount == 0) &&
+                shardOfMonth.emplace(entry.month, static_cast<uint32_t>(i)).second;
+        total += entry.taskCount;
+        deadTotal += entry.deadCount;
+    }
+    valid = valid && fileSize == entryBytes + deadTotal * sizeof(uint32_t);
+    vector<uint32_t> deadRows(valid ? deadTotal : 0);
+    inFile.read(reinterpret_cast<char*>(deadRows.data()), static_cast<streamsize>(deadRows.size() * sizeof(uint32_t)));
+    valid = valid && inFile;
+    const uint32_t* rows = deadRows.data();
+    for (size_t i = 0; valid && i < entries.size(); rows += entries[i++].deadCount) {
+        for (uint32_t k = 0; valid && k < entries[i].deadCount; ++k) valid = rows[k] < entries[i].taskCount && (k == 0 || rows[k - 1] < rows[k]);
+    }
+    if (!valid || total != header.taskCount) {
+        cout << SHARD_INDEX_FILE << " is damaged or was written by a newer version and was not loaded." << endl;
+        return false;
+    }
+
+    unordered_set<string> listed = {filesystem::path(SHARD_INDEX_FILE).filename().string()};
+    shardStore = ShardStore();
+    rows = deadRows.data();
+    for (const ShardIndexEntry& entry : entries) {
+        Shard shard;
+        shard.month = entry.month;
+        shard.generation = entry.generation;
+        shard.storedCount = entry.taskCount;
+        shard.bloomOffset = entry.bloomOffset;
+        shard.bloomBytes = entry.bloomBytes;
+        shard.deadRows.assign(rows, rows + entry.deadCount);
+        rows += entry.deadCount;
+        shardStore.shards.push_back(move(shard));
+        listed.insert(filesystem::path(shardFileName(entry.month, entry.generation)).filename().string());
+    }
+    shardStore.shardOfMonth = move(shardOfMonth);
+    shardStore.loaded = shardStore.shards.empty();
+    shardStore.taskCount = header.taskCount - deadTotal;
+    shardStore.nextGeneration = header.nextGeneration;
+    shardStore.compressed = (header.flags & SHARD_INDEX_COMPRESSED) != 0;
+    if (!compressionChosen) compressSnapshots = shardStore.compressed;  // Keep the format unless the command line says otherwise
+    lastJournalSeq = header.journalSeq;
+
+    // Remove files left behind by a save that was cut short before its index was written
+    filesystem::directory_iterator end;
+    for (filesystem::directory_iterator entry(SHARD_DIRECTORY, error); !error && entry != end; entry.increment(error)) {
+        if (!listed.count(entry->path().filename().string())) filesystem::remove(entry->path(), error);
+    }
+    return true;
+}
+
+
+// Function to describe a shard for the shard index
+ShardIndexEntry shardIndexEntry(const Shard& shard) {
+    // Precondition: The shard has a file.
+    // Post condition: Returns the index entry listing the shard's file.
+
+    return {shard.month, static_cast<uint32_t>(shard.deadRows.size()), shard.generation, shard.storedCount, shard.bloomOffset, shard.bloomBytes};
+}
+
+
+// Function to write the shard index
+bool writeShardIndex(vector<ShardIndexEntry>& entries, const vector<vector<uint32_t>>& deadRows, const SaveJob& job) {
+    // Precondition: Every file listed in 'entries' has been written; 'deadRows' holds the dead rows of each entry.
+    // Post condition: Returns true if an index listing those files and their dead rows, in month order, replaced the old one.
+
+    ShardIndexHeader header = {};
+    memcpy(header.magic, SHARD_INDEX_MAGIC, sizeof(header.magic));
+    header.version = SHARD_INDEX_VERSION;
+    header.journalSeq = job.journalSeq;
+    header.nextGeneration = job.nextGeneration;
+    header.shardCount = static_cast<uint32_t>(entries.size());
+    header.flags = job.compressed ? uint32_t(SHARD_INDEX_COMPRESSED) : 0u;
+    vector<uint32_t> order(entries.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return entries[a].month < entries[b].month; });
+    size_t deadCount = 0;
+    for (const ShardIndexEntry& entry : entries) {
+        header.taskCount += entry.taskCount;
+        deadCount += entry.deadCount;
+    }
+
+    vector<char> buffer(sizeof(header) + entries.size() * sizeof(ShardIndexEntry) + deadCount * sizeof(uint32_t));
+    memcpy(buffer.data(), &header, sizeof(header));
+    char* entryOut = buffer.data() + sizeof(header);
+    char* rowOut = entryOut + entries.size() * sizeof(ShardIndexEntry);
+    for (uint32_t i : order) {
+        memcpy(entryOut, &entries[i], sizeof(ShardIndexEntry));
+        entryOut += sizeof(ShardIndexEntry);
+        if (deadRows[i].empty()) continue;
+        vector<uint32_t> rows = deadRows[i];
+        sort(rows.begin(), rows.end());  // Deletes arrive in any order
+        memcpy(rowOut, rows.data(), rows.size() * sizeof(uint32_t));
+        rowOut += rows.size() * sizeof(uint32_t);
+    }
+    return writeFileAtomically(SHARD_INDEX_FILE, buffer.data(), buffer.size());
+}
+
+
+// Function to read every shard the first time the whole list is needed
+void ensureTasksLoaded(CowVector<Task>& tasks) {
+    // Precondition: None
+    // Post condition: 'tasks' holds the whole list in its saved order, with the pending journal records applied.
+
+    // Adds check titles against the shards' filters and due date listings read only their months, but everything
+    // else loads the whole list: viewing, searching, queries, sorts, statistics and every command naming a task by
+    // number or ID, since those are resolved against the whole list
+    if (shardStore.loaded) return;
+    shardStore.loaded = true;
+
+    // Read the shards in parallel; every file records the list position of its tasks, so they merge back in order
+    vector<Shard>& shards = shardStore.shards;
+    vector<TaskFileContents> contents(shards.size());
+    vector<char> readable(shards.size(), 0);
+    runInParallel(shards.size(), [&](size_t s) {
+        readable[s] = readTaskFile(shardFileName(shards[s].month, shards[s].generation), contents[s]) &&
+                      contents[s].tasks.size() >= shards[s].storedCount && contents[s].positions.size() >= shards[s].storedCount;
+    });
+
+    // Check that the positions cover the whole list exactly once before trusting them
+    const uint32_t UNPLACED = UINT32_MAX;
+    uint64_t total = 0;
+    for (const Shard& shard : shards) total += shard.storedCount;
+    shardStore.taskShard.assign(total, UNPLACED);
+    shardStore.taskSlot.assign(total, 0);
+    bool intact = true;
+    for (size_t s = 0; s < shards.size(); ++s) {
+        if (!readable[s]) {
+            cout << shardFileName(shards[s].month, shards[s].generation) << " could not be read; its tasks are missing." << endl;
+            intact = false;
+            continue;
+        }
+        for (uint32_t slot = 0; slot < shards[s].storedCount; ++slot) {
+            uint32_t position = contents[s].positions[slot];
+            if (position >= total || shardStore.taskShard[position] != UNPLACED) {
+                intact = false;
+                continue;
+            }
+            shardStore.taskShard[position] = static_cast<uint32_t>(s);
+            shardStore.taskSlot[position] = slot;
+        }
+    }
+
+    if (intact) {
+        tasks.resize(total);
+        for (uint64_t position = 0; position < total; ++position) {
+            tasks.edit(position) = move(contents[shardStore.taskShard[position]].tasks[shardStore.taskSlot[position]]);
+        }
+        for (size_t s = 0; s < shards.size(); ++s) {
+            shards[s].members.resize(shards[s].storedCount);
+            shards[s].file = move(contents[s].state);
+            shards[s].file.taskCount = shards[s].storedCount;  // Slots past the index's count are left over from an unfinished save
+            shards[s].titleBloom = move(contents[s].titleBloom);
+        }
+        for (uint64_t position = 0; position < total; ++position) {
+            shards[shardStore.taskShard[position]].members[shardStore.taskSlot[position]] = static_cast<uint32_t>(position);
+        }
+
+        // Deleted tasks keep their slots until the list is next compacted
+        for (const Shard& shard : shards) {
+            for (uint32_t slot : shard.deadRows) buryTask(shard.members[slot], total);
+        }
+    } else {
+        // Keep whatever could be read, shard by shard, and regroup everything at the next save
+        tasks.clear();
+        for (size_t s = 0; s < shards.size(); ++s) {
+            if (!readable[s]) continue;
+            const vector<uint32_t>& dead = shards[s].deadRows;
+            for (uint64_t slot = 0, next = 0; slot < shards[s].storedCount; ++slot) {
+                if (next < dead.size() && dead[next] == slot) ++next;  // A deleted task
+                else tasks.push_back(move(contents[s].tasks[slot]));
+            }
+        }
+        regroupShards(tasks);
+    }
+    for (TaskFileContents& file : contents) keepTitleStorage(file);
+
+    // Changes made while only the index was loaded come on top
+    for (const JournalRecord& record : shardStore.pendingRecords) {
+        bool needsTask = record.op == JOURNAL_EDIT || record.op == JOURNAL_DELETE || record.op == JOURNAL_COMPLETE;
+        if (needsTask && record.index >= countTasks(tasks)) break;  // Only possible if a shard was lost
+        applyJournalRecord(tasks, record);
+    }
+    unsavedChanges += shardStore.pendingRecords.size();  // Autosave only starts counting once the list is loaded
+    shardStore.pendingRecords.clear();
+}
+
+
+// Function to check whether a title is taken while only the shard index is loaded
+TitleLookup lookUpTitleInShards(string_view title) {
+    // Precondition: The shards are not loaded.
+    // Post condition: Returns whether a task has 'title', or TITLE_UNKNOWN if only the whole list can tell.
+
+    // A title named by a pending record may have changed again since, which only the whole list shows
+    bool pendingRemovals = false;
+    for (const JournalRecord& record : shardStore.pendingRecords) {
+        if ((record.op == JOURNAL_ADD || record.op == JOURNAL_EDIT) && record.task.title == title) return TITLE_UNKNOWN;
+        if (record.op == JOURNAL_EDIT || record.op == JOURNAL_DELETE) pendingRemovals = true;
+    }
+
+    // A shard whose title filter rules the title out is never read; only a match costs reading the shard. Every
+    // filter is read once and then kept, so a check costs a few bit tests per month, hashing the title only once
+    uint64_t hash = hashTitle(title);
+    for (Shard& shard : shardStore.shards) {
+        if (shard.titleBloom.empty() && !readTitleBloom(shard)) return TITLE_UNKNOWN;
+        if (!bloomMayContain(shard.titleBloom, hash)) continue;
+
+        TaskFileContents contents;
+        if (!readTaskFile(shardFileName(shard.month, shard.generation), contents)) return TITLE_UNKNOWN;
+        bool found = false;
+        for (size_t i = 0; !found && i < min<uint64_t>(contents.tasks.size(), shard.storedCount); ++i) {
+            found = contents.tasks[i].title == title && !binary_search(shard.deadRows.begin(), shard.deadRows.end(), i);
+        }
+        unmapFile(contents.mapping);
+        if (found) return pendingRemovals ? TITLE_UNKNOWN : TITLE_PRESENT;
+    }
+    return TITLE_ABSENT;
+}
+
+
+// Function to read the title bloom filter of a shard file
+bool readTitleBloom(Shard& shard) {
+    // Precondition: The shard has a file.
+    // Post condition: Returns true and fills 'shard.titleBloom' if the filter was read.
+
+    ifstream inFile(shardFileName(shard.month, shard.generation), ios::binary);
+    shard.titleBloom.resize(shard.bloomBytes);
+    inFile.seekg(static_cast<streamoff>(shard.bloomOffset));
+    inFile.read(reinterpret_cast<char*>(shard.titleBloom.data()), static_cast<streamsize>(shard.titleBloom.size()));
+    if (!inFile || shard.titleBloom.empty()) {
+        shard.titleBloom.clear();
+        return false;
+    }
+    return true;
+}
+
+
+// Function to hash a title for the title bloom filters and the title index
+uint64_t hashTitle(string_view title) {
+    // Precondition: None
+    // Post condition: Returns the 64-bit FNV-1a hash of 'title', which is the same on every platform since it is stored in files.
+
+    uint64_t hash = 14695981039346656037ull;
+    for (char byte : title) hash = (hash ^ static_cast<uint8_t>(byte)) * 1099511628211ull;
+    return hash;
+}
+
+
+// Function to check whether a task already has a title
+bool titleTaken(CowVector<Task>& tasks, const TaskTitle& title) {
+    // Precondition: None
+    // Post condition: Returns true if a task has 'title'. While the shards are unloaded their title filters usually
+    //                 settle it; otherwise the shards are loaded and the title index answers.
+
+    TitleLookup lookup = shardStore.loaded ? TITLE_UNKNOWN : lookUpTitleInShards(title);
+    if (lookup != TITLE_UNKNOWN) return lookup == TITLE_PRESENT;
+    return findTaskByTitle(tasks, title) != NO_TASK;
+}
+
+
+// Function to find the task with a given title
+size_t findTaskByTitle(CowVector<Task>& tasks, const TaskTitle& title) {
+    // Precondition: None
+    // Post condition: Returns the position of the task titled 'title', or NO_TASK. The shards and the title index
+    //                 are loaded and built first if needed.
+
+    ensureTasksLoaded(tasks);
+    ensureTitleIndex(tasks);
+    return findTitle(tasks, title, hashTitle(title));
+}
+
+
+// Function to build the title index
+void ensureTitleIndex(const CowVector<Task>& tasks) {
+    // Precondition: The shards are loaded.
+    // Post condition: The title index holds every task. Of several tasks with the same title, the first is indexed.
+
+    if (titleIndex.built) return;
+    titleIndex.slots.assign(max<size_t>(16, bit_ceil(tasks.size() * 2)), 0);
+    titleIndex.count = 0;
+    titleIndex.built = true;
+
+    // Hash on every core, then insert in order; the table is far larger than the caches, so the slot for a title
+    // a little further on is requested early
+    size_t threadCount = min<size_t>(max(1u, thread::hardware_concurrency()), tasks.size() / MIN_THREAD_TASKS + 1);
+    vector<uint64_t> hashes(tasks.size());
+    runInParallel(threadCount, [&](size_t t) {
+        size_t last = tasks.size() * (t + 1) / threadCount;
+        for (size_t i = tasks.size() * t / threadCount; i < last; ++i) hashes[i] = hashTitle(tasks[i].title);
+    });
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (i + TITLE_PREFETCH_DISTANCE < tasks.size()) prefetchTitleSlot(hashes[i + TITLE_PREFETCH_DISTANCE]);
+        if (!isDeadSlot(i) && findTitle(tasks, tasks[i].title, hashes[i]) == NO_TASK) indexTitle(tasks, i, hashes[i]);
+    }
+}
+
+
+// Function to make room in the title index
+void reserveTitleIndex(const CowVector<Task>& tasks, size_t count) {
+    // Precondition: The title index is built.
+    // Post condition: 'count' titles fit in the table while it stays at most half full.
+
+    if (titleIndex.slots.size() >= count * 2) return;
+    vector<uint64_t> old(bit_ceil(count * 2), 0);
+    old.swap(titleIndex.slots);
+    const size_t mask = titleIndex.slots.size() - 1;
+    for (uint64_t entry : old) {
+        if (entry == 0) continue;
+        size_t slot = hashTitle(tasks[(entry & UINT32_MAX) - 1].title) & mask;
+        while (titleIndex.slots[slot] != 0) slot = (slot + 1) & mask;
+        titleIndex.slots[slot] = entry;
+    }
+}
+
+
+// Function to look a title up in the title index
+size_t findTitle(const CowVector<Task>& tasks, const TaskTitle& title, uint64_t hash) {
+    // Precondition: The title index is built and 'hash' is hashTitle(title).
+    // Post condition: Returns the position of the indexed task titled 'title', or NO_TASK.
+
+    const size_t mask = titleIndex.slots.size() - 1;
+    const uint64_t tag = hash >> 32;
+    for (size_t slot = hash & mask; titleIndex.slots[slot] != 0; slot = (slot + 1) & mask) {
+        uint64_t entry = titleIndex.slots[slot];
+        // A task holding the very copy 'title' names matches on its handle, which saves comparing the bytes
+        if (entry >> 32 == tag && tasks[(entry & UINT32_MAX) - 1].title == title) return (entry & UINT32_MAX) - 1;
+    }
+    return NO_TASK;
+}
+
+
+// Function to add a task's title to the title index
+void indexTitle(const CowVector<Task>& tasks, size_t position, uint64_t hash) {
+    // Precondition: 'hash' is hashTitle of the title of the task at 'position', which is not indexed yet.
+    // Post condition: The title leads to 'position'. Nothing happens while the index is not built.
+
+    if (!titleIndex.built) return;
+    reserveTitleIndex(tasks, titleIndex.count + 1);
+    const size_t mask = titleIndex.slots.size() - 1;
+    size_t slot = hash & mask;
+    while (titleIndex.slots[slot] != 0) slot = (slot + 1) & mask;
+    titleIndex.slots[slot] = (hash >> 32) << 32 | (position + 1);
+    ++titleIndex.count;
+}
+
+
+// Function to remove a task's title from the title index
+void unindexTitle(const CowVector<Task>& tasks, size_t position) {
+    // Precondition: The task at 'position' still has the title it was indexed under.
+    // Post condition: The title no longer leads to 'position'. Nothing happens while the index is not built.
+
+    if (!titleIndex.built) return;
+    const size_t mask = titleIndex.slots.size() - 1;
+    size_t slot = hashTitle(tasks[position].title) & mask;
+    while (titleIndex.slots[slot] != 0 && (titleIndex.slots[slot] & UINT32_MAX) != position + 1) slot = (slot + 1) & mask;
+    if (titleIndex.slots[slot] == 0) return;  // A duplicate title that was never indexed
+
+    // Close the gap: move back every later entry of the run that may not be found past an empty slot otherwise
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask; titleIndex.slots[next] != 0; next = (next + 1) & mask) {
+        size_t home = hashTitle(tasks[(titleIndex.slots[next] & UINT32_MAX) - 1].title) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            titleIndex.slots[hole] = titleIndex.slots[next];
+            hole = next;
+        }
+    }
+    titleIndex.slots[hole] = 0;
+    --titleIndex.count;
+}
+
+
+// Function to start loading the title index slot a hash starts at
+void prefetchTitleSlot(uint64_t hash) {
+    // Precondition: The title index is built.
+    // Post condition: None; the slot is merely on its way into the cache.
+
+#ifdef USE_SSE2
+    _mm_prefetch(reinterpret_cast<const char*>(&titleIndex.slots[hash & (titleIndex.slots.size() - 1)]), _MM_HINT_T0);
+#else
+    (void)hash;
+#endif
+}
+
+
+// Function to count the days to a calendar date
+uint32_t civilDay(int year, int month, int day) {
+    // Precondition: 'year', 'month' and 'day' form a real date in the years 0 to 9999.
+    // Post condition: Returns the number of days from 0000-01-01 to the date, plus one, so it is never NO_DUE_DAY.
+
+    // Counting from March makes the leap day the last day of the year; shifting by 400 years keeps 'y' positive
+    uint32_t y = static_cast<uint32_t>(year + 400 - (month <= 2));
+    uint32_t era = y / 400;
+    uint32_t yearOfEra = y - era * 400;
+    uint32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - DAY_NUMBER_SHIFT;
+}
+
+
+// Function to turn a due date into a day number
+uint32_t dayNumber(string_view dueDate) {
+    // Precondition: None
+    // Post condition: Returns civilDay of the date, or NO_DUE_DAY if it is not a valid YYYY-MM-DD date.
+
+    if (!isValidDate(dueDate)) return NO_DUE_DAY;
+    auto digits = [&](size_t first, size_t count) {
+        int value = 0;
+        for (size_t i = first; i < first + count; ++i) value = value * 10 + (dueDate[i] - '0');
+        return value;
+    };
+    return civilDay(digits(0, 4), digits(5, 2), digits(8, 2));
+}
+
+
+// Function to write a day number as a date
+void formatDay(uint32_t day, char* out) {
+    // Precondition: 'out' has room for DUE_DATE_LENGTH characters.
+    // Post condition: 'out' holds the date as YYYY-MM-DD, not null-terminated, or NO_DUE_DATE_TEXT for NO_DUE_DAY.
+
+    if (day == NO_DUE_DAY) {
+        memcpy(out, NO_DUE_DATE_TEXT, DUE_DATE_LENGTH);
+        return;
+    }
+    // The inverse of civilDay
+    uint32_t shifted = day + DAY_NUMBER_SHIFT;
+    uint32_t era = shifted / 146097;
+    uint32_t dayOfEra = shifted - era * 146097;
+    uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    uint32_t shiftedMonth = (5 * dayOfYear + 2) / 153;
+    uint32_t dayOfMonth = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    uint32_t month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    uint32_t year = yearOfEra + era * 400 + (month <= 2) - 400;
+    auto put = [&](uint32_t value, size_t first, size_t count) {
+        for (size_t i = first + count; i-- > first; value /= 10) out[i] = static_cast<char>('0' + value % 10);
+    };
+    put(year, 0, 4);
+    out[4] = '-';
+    put(month, 5, 2);
+    out[7] = '-';
+    put(dayOfMonth, 8, 2);
+}
+
+
+// Function to return a day number as a date
+string dayText(uint32_t day) {
+    // Precondition: None
+    // Post condition: Returns the date as formatDay writes it.
+
+    string text(DUE_DATE_LENGTH, ' ');
+    formatDay(day, text.data());
+    return text;
+}
+
+
+// Function to return today's date
+uint32_t today() {
+    // Precondition: None
+    // Post condition: Returns the local date as a day number.
+
+    time_t now = time(nullptr);
+    tm local = {};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    return civilDay(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+}
+
+
+// Function to bring a priority read from a file into range
+uint8_t clampPriority(int64_t priority) {
+    // Precondition: None
+    // Post condition: Returns the priority, raised to MIN_PRIORITY or lowered to MAX_PRIORITY if it lies outside.
+
+    return static_cast<uint8_t>(clamp<int64_t>(priority, MIN_PRIORITY, MAX_PRIORITY));
+}
+
+
+// Function to build the due date index
+void ensureDueDateIndex(const CowVector<Task>& tasks) {
+    // Precondition: The shards are loaded.
+    // Post condition: The due date index holds every task, all of them in the sorted array.
+
+    if (dueDateIndex.built) return;
+    dueDateIndex.sorted.resize(tasks.size());
+    dueDateIndex.recent.clear();
+    size_t threadCount = min<size_t>(max(1u, thread::hardware_concurrency()), tasks.size() / MIN_THREAD_TASKS + 1);
+    runInParallel(threadCount, [&](size_t t) {
+        size_t last = tasks.size() * (t + 1) / threadCount;
+        for (size_t i = tasks.size() * t / threadCount; i < last; ++i) {
+            dueDateIndex.sorted[i] = uint64_t(tasks[i].dueDay) << 32 | i;
+        }
+    });
+    sort(dueDateIndex.sorted.begin(), dueDateIndex.sorted.end());
+    dueDateIndex.built = true;
+}
+
+
+// Function to add a task to the due date index
+void indexDueDate(const CowVector<Task>& tasks, size_t position, uint32_t key) {
+    // Precondition: The task at 'position' is live and 'key' is its due day, new or changed.
+    // Post condition: The index has the task's current entry. Nothing happens while the index is not built.
+
+    if (!dueDateIndex.built) return;
+    uint64_t entry = uint64_t(key) << 32 | position;
+    // The entry is there already if the due date changed back
+    vector<uint64_t>& sorted = dueDateIndex.sorted;
+    if (binary_search(sorted.begin(), sorted.end(), entry)) return;
+    vector<uint64_t>& recent = dueDateIndex.recent;
+    auto place = lower_bound(recent.begin(), recent.end(), entry);
+    if (place != recent.end() && *place == entry) return;
+    recent.insert(place, entry);
+    if (recent.size() < DUE_DATE_DELTA_LIMIT) return;
+
+    // Merge the delta buffer into the sorted array, which passes over every entry anyway, so the entries of
+    // deleted tasks and those left behind by new due dates go with it
+    size_t middle = sorted.size();
+    sorted.insert(sorted.end(), recent.begin(), recent.end());
+    inplace_merge(sorted.begin(), sorted.begin() + middle, sorted.end());
+    sorted.erase(remove_if(sorted.begin(), sorted.end(), [&](uint64_t old) { return !isCurrentDueEntry(tasks, old); }), sorted.end());
+    recent.clear();
+}
+
+
+// Function to check that a due date index entry still describes its task
+bool isCurrentDueEntry(const CowVector<Task>& tasks, uint64_t entry) {
+    // Precondition: 'entry' is an entry of the due date index, which is built.
+    // Post condition: Returns true if the entry's slot holds a live task that is still due on the entry's day.
+
+    size_t slot = entry & UINT32_MAX;
+    return !isDeadSlot(slot) && tasks[slot].dueDay == entry >> 32;
+}
+
+
+// Function to list the tasks due in a range of dates
+void findDueTasks(const CowVector<Task>& tasks, uint32_t first, uint32_t last, bool pendingOnly, size_t limit, vector<size_t>& out) {
+    // Precondition: The due date index is built. 'first' and 'last' are day numbers.
+    // Post condition: 'out' holds the positions of up to 'limit' tasks due from 'first' to 'last', both included,
+    //                 in due date order; with 'pendingOnly' completed tasks are left out.
+
+    out.clear();
+    if (first > last) return;
+    const vector<uint64_t>& sorted = dueDateIndex.sorted;
+    const vector<uint64_t>& recent = dueDateIndex.recent;
+    uint64_t lowest = uint64_t(first) << 32;
+    uint64_t highest = uint64_t(last) << 32 | UINT32_MAX;
+    auto older = lower_bound(sorted.begin(), sorted.end(), lowest);
+    auto newer = lower_bound(recent.begin(), recent.end(), lowest);
+    while (out.size() < limit) {
+        // Take the smaller of the next entries of the two arrays
+        bool useOlder = newer == recent.end() || (older != sorted.end() && *older < *newer);
+        if (useOlder ? older == sorted.end() : newer == recent.end()) break;
+        uint64_t entry = useOlder ? *older++ : *newer++;
+        if (entry > highest) break;
+        size_t position = entry & UINT32_MAX;
+        if (!isCurrentDueEntry(tasks, entry)) continue;
+        if (!pendingOnly || !tasks[position].completed) out.push_back(position);
+    }
+}
+
+
+// Function to list the tasks due in a range of dates while only the shard index is loaded
+bool listDueTasksInShards(uint32_t first, uint32_t last, bool pendingOnly, size_t limit) {
+    // Precondition: The shards are not loaded. 'first' and 'last' are day numbers and 'first' is not NO_DUE_DAY.
+    // Post condition: Returns true after displaying the tasks findDueTasks would list, numbered as the whole list
+    //                 would number them. Returns false, having displayed nothing, if only the whole list can tell:
+    //                 journal records are pending or a shard could not be read.
+
+    if (!shardStore.pendingRecords.empty()) return false;
+    vector<Shard>& shards = shardStore.shards;
+    vector<TaskFileContents> contents(shards.size());
+    vector<char> read(shards.size(), 0);
+    auto readShard = [&](uint32_t s) {
+        if (read[s]) return true;
+        read[s] = 1;
+        return readTaskFile(shardFileName(shards[s].month, shards[s].generation), contents[s]) &&
+               contents[s].tasks.size() >= shards[s].storedCount && contents[s].positions.size() >= shards[s].storedCount;
+    };
+    auto release = [&] {
+        for (TaskFileContents& file : contents) unmapFile(file.mapping);
+    };
+    uint64_t total = 0;
+    for (const Shard& shard : shards) total += shard.storedCount;
+
+    // Each shard holds one month, so only the months the range touches are read, earliest first. Once enough tasks
+    // are found, the later months can only hold later ones
+    vector<uint32_t> months;
+    for (uint32_t s = 0; s < shards.size(); ++s) {
+        uint32_t month = shards[s].month;
+        if (month != 0 && month >= dueMonth(first) && civilDay(month / 100, month % 100, 1) <= last) months.push_back(s);
+    }
+    sort(months.begin(), months.end(), [&](uint32_t a, uint32_t b) { return shards[a].month < shards[b].month; });
+    vector<pair<uint64_t, const Task*>> found;  // Due day above list position, as in the due date index
+    for (uint32_t s : months) {
+        if (found.size() >= limit) break;
+        if (!readShard(s)) {
+            release();
+            return false;
+        }
+        for (uint32_t slot = 0; slot < shards[s].storedCount; ++slot) {
+            const Task& task = contents[s].tasks[slot];
+            if (task.dueDay < first || task.dueDay > last || (pendingOnly && task.completed)) continue;
+            if (binary_search(shards[s].deadRows.begin(), shards[s].deadRows.end(), slot)) continue;
+            uint32_t position = contents[s].positions[slot];
+            if (position >= total) {
+                release();
+                return false;
+            }
+            found.push_back({uint64_t(task.dueDay) << 32 | position, &task});
+        }
+    }
+
+    // A task is numbered by the live tasks before it, so the positions of the dead rows are needed too; a shard
+    // outside the range is read for them only if it has any
+    vector<uint32_t> deadPositions;
+    for (uint32_t s = 0; s < shards.size() && !found.empty(); ++s) {
+        if (shards[s].deadRows.empty()) continue;
+        if (!readShard(s)) {
+            release();
+            return false;
+        }
+        for (uint32_t slot : shards[s].deadRows) deadPositions.push_back(contents[s].positions[slot]);
+    }
+    sort(deadPositions.begin(), deadPositions.end());
+
+    // A freshly loaded list hands out its IDs in list order, so a task's ID matches its number
+    sort(found.begin(), found.end());
+    for (size_t i = 0; i < found.size() && i < limit; ++i) {
+        uint32_t position = found[i].first & UINT32_MAX;
+        uint64_t number = position - (lower_bound(deadPositions.begin(), deadPositions.end(), position) - deadPositions.begin()) + 1;
+        printTaskLine(*found[i].second, number, "#" + to_string(number));
+    }
+    if (found.empty()) cout << "No tasks found." << endl;
+    release();
+    return true;
+}
+
+
+// Function to build the priority index
+void ensurePriorityIndex(const CowVector<Task>& tasks) {
+    // Precondition: The shards are loaded.
+    // Post condition: The priority index holds every task.
+
+    if (priorityIndex.built) return;
+    for (int status = 0; status < 2; ++status) {
+        for (vector<uint32_t>& bucket : priorityIndex.buckets[status]) bucket.clear();
+        fill(begin(priorityIndex.unordered[status]), end(priorityIndex.unordered[status]), false);
+        priorityIndex.occupied[status][0] = priorityIndex.occupied[status][1] = 0;
+    }
+    priorityIndex.places.assign(tasks.size(), 0);
+    priorityIndex.built = true;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (!isDeadSlot(i)) indexPriority(i, tasks[i].priority, tasks[i].completed);
+    }
+}
+
+
+// Function to add a task to the priority index
+void indexPriority(size_t position, uint8_t priority, bool completed) {
+    // Precondition: The task at 'position' is not in the index.
+    // Post condition: The task is in its bucket. Nothing happens while the index is not built.
+
+    if (!priorityIndex.built) return;
+    size_t bucketNumber = priority;
+    vector<uint32_t>& bucket = priorityIndex.buckets[completed][bucketNumber];
+    uint32_t entry = static_cast<uint32_t>(position);
+    // New tasks are last in the list, so they nearly always keep the bucket in order
+    if (!bucket.empty() && bucket.back() > entry) priorityIndex.unordered[completed][bucketNumber] = true;
+    if (position >= priorityIndex.places.size()) priorityIndex.places.resize(position + 1);
+    priorityIndex.places[position] = static_cast<uint32_t>(bucket.size());
+    bucket.push_back(entry);
+    priorityIndex.occupied[completed][bucketNumber / 64] |= uint64_t(1) << (bucketNumber % 64);
+}
+
+
+// Function to remove a task from the priority index
+void unindexPriority(size_t position, uint8_t priority, bool completed) {
+    // Precondition: 'priority' and 'completed' are what the task at 'position' was indexed under.
+    // Post condition: The task is no longer in the index. Nothing happens while the index is not built.
+
+    if (!priorityIndex.built || position >= priorityIndex.places.size()) return;
+    size_t bucketNumber = priority;
+    vector<uint32_t>& bucket = priorityIndex.buckets[completed][bucketNumber];
+    uint32_t place = priorityIndex.places[position];
+    if (place >= bucket.size() || bucket[place] != position) return;
+
+    // The bucket's last entry fills the gap
+    if (place + 1 != bucket.size()) {
+        bucket[place] = bucket.back();
+        priorityIndex.places[bucket[place]] = place;
+        priorityIndex.unordered[completed][bucketNumber] = true;
+    }
+    bucket.pop_back();
+    if (bucket.empty()) priorityIndex.occupied[completed][bucketNumber / 64] &= ~(uint64_t(1) << (bucketNumber % 64));
+}
+
+
+// Function to find the pending task with the highest priority
+size_t highestPendingTask() {
+    // Precondition: The priority index is built.
+    // Post condition: Returns the position of the earliest pending task with the highest priority, or NO_TASK if
+    //                 every task is completed.
+
+    const uint64_t* words = priorityIndex.occupied[0];
+    for (int word = 1; word >= 0; --word) {
+        if (words[word] == 0) continue;
+        size_t bucketNumber = word * 64 + 63 - countl_zero(words[word]);
+        return orderedPriorityBucket(0, bucketNumber).front();
+    }
+    return NO_TASK;
+}
+
+
+// Function to put a priority bucket back in list order
+const vector<uint32_t>& orderedPriorityBucket(int status, size_t bucketNumber) {
+    // Precondition: The priority index is built. 'status' is 1 for completed tasks, 0 otherwise.
+    // Post condition: Returns the bucket, its positions in ascending order and their places updated to match.
+
+    vector<uint32_t>& bucket = priorityIndex.buckets[status][bucketNumber];
+    if (priorityIndex.unordered[status][bucketNumber]) {
+        sort(bucket.begin(), bucket.end());
+        for (size_t place = 0; place < bucket.size(); ++place) priorityIndex.places[bucket[place]] = static_cast<uint32_t>(place);
+        priorityIndex.unordered[status][bucketNumber] = false;
+    }
+    return bucket;
+}
+
+
+// Function to list the tasks at or above a priority
+void findTasksByPriority(int minPriority, bool pendingOnly, vector<size_t>& out) {
+    // Precondition: The priority index is built.
+    // Post condition: 'out' holds the positions of the tasks with priority 'minPriority' or higher, highest priority
+    //                 first and in list order within a priority; with 'pendingOnly' completed tasks are left out.
+
+    out.clear();
+    size_t lowest = clamp(minPriority, MIN_PRIORITY, MAX_PRIORITY);
+    for (int word = 1; word >= 0; --word) {
+        uint64_t bits = priorityIndex.occupied[0][word] | (pendingOnly ? 0 : priorityIndex.occupied[1][word]);
+        // Drop the buckets below 'lowest'
+        if (lowest >= size_t(word + 1) * 64) bits = 0;
+        else if (lowest > size_t(word) * 64) bits &= ~uint64_t(0) << (lowest - word * 64);
+        while (bits != 0) {
+            int bit = 63 - countl_zero(bits);
+            bits &= ~(uint64_t(1) << bit);
+            const vector<uint32_t>& pending = orderedPriorityBucket(0, word * 64 + bit);
+            if (pendingOnly) {
+                out.insert(out.end(), pending.begin(), pending.end());
+            } else {
+                const vector<uint32_t>& completed = orderedPriorityBucket(1, word * 64 + bit);
+                merge(pending.begin(), pending.end(), completed.begin(), completed.end(), back_inserter(out));
+            }
+        }
+    }
+}
+
+
+// Function to build the task columns
+void ensureTaskColumns(const CowVector<Task>& tasks) {
+    // Precondition: The shards are loaded.
+    // Post condition: The columns hold the fields of every task.
+
+    if (taskColumns.built) return;
+    taskColumns.dueDays.resize(tasks.size());
+    taskColumns.priorities.resize(tasks.size());
+    taskColumns.completed.assign((tasks.size() + 63) / 64, 0);
+    taskColumns.built = true;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (isDeadSlot(i)) clearTaskColumns(i);
+        else storeTaskColumns(i, tasks[i]);
+    }
+}
+
+
+// Function to copy a task's filtered fields into the columns
+void storeTaskColumns(size_t position, const Task& task) {
+    // Precondition: 'position' is at most the number of tasks in the columns.
+    // Post condition: Position 'position' of the columns holds the task's fields, appended if it is one past the
+    //                 end. Nothing happens while the columns are not built.
+
+    if (!taskColumns.built) return;
+    if (position == taskColumns.dueDays.size()) {
+        taskColumns.dueDays.push_back(task.dueDay);
+        taskColumns.priorities.push_back(task.priority);
+        if (position % 64 == 0) taskColumns.completed.push_back(0);
+    } else {
+        taskColumns.dueDays[position] = task.dueDay;
+        taskColumns.priorities[position] = task.priority;
+    }
+    uint64_t bit = uint64_t(1) << (position % 64);
+    if (task.completed) taskColumns.completed[position / 64] |= bit;
+    else taskColumns.completed[position / 64] &= ~bit;
+}
+
+
+// Function to mark a dead slot in the columns
+void clearTaskColumns(size_t position) {
+    // Precondition: 'position' is a position in the columns.
+    // Post condition: The slot holds DEAD_SLOT_PRIORITY, which no filter matches, and is not counted as completed.
+    //                 Nothing happens while the columns are not built.
+
+    if (!taskColumns.built) return;
+    taskColumns.priorities[position] = DEAD_SLOT_PRIORITY;
+    taskColumns.completed[position / 64] &= ~(uint64_t(1) << (position % 64));
+}
+
+
+// Function to count the completed tasks
+size_t countCompleted(const vector<uint64_t>* selection) {
+    // Precondition: The task columns are built; 'selection', if given, has a bit per task as filterTasks makes it.
+    // Post condition: Returns the number of completed tasks, or of completed tasks selected in 'selection'.
+
+    static const BitCounter counter = chooseBitCounter();
+    const vector<uint64_t>& words = taskColumns.completed;
+    return counter(words.data(), selection ? selection->data() : nullptr, words.size());
+}
+
+
+// Function to pick the bit counter
+BitCounter chooseBitCounter() {
+    // Precondition: None
+    // Post condition: Returns the POPCNT counter if this build has it and the processor supports it, else the plain one.
+
+#ifdef USE_AVX2
+    if (__builtin_cpu_supports("popcnt")) return countBitsPopcnt;
+#endif
+    return countBitsPortable;
+}
+
+
+// Function to count the bits set in an array
+size_t countBitsPortable(const uint64_t* words, const uint64_t* mask, size_t count) {
+    // Precondition: 'words', and 'mask' if given, hold 'count' words.
+    // Post condition: Returns the number of bits set in 'words', or in 'words' AND 'mask'.
+
+    size_t total = 0;
+    if (mask) {
+        for (size_t i = 0; i < count; ++i) total += popcount(words[i] & mask[i]);
+    } else {
+        for (size_t i = 0; i < count; ++i) total += popcount(words[i]);
+    }
+    return total;
+}
+
+
+#ifdef USE_AVX2
+// Function to count the bits set in an array with the POPCNT instruction
+__attribute__((target("popcnt")))
+size_t countBitsPopcnt(const uint64_t* words, const uint64_t* mask, size_t count) {
+    // Precondition: As for countBitsPortable; the processor supports POPCNT.
+    // Post condition: As for countBitsPortable.
+
+    // The same loops, which the target attribute lets the compiler turn into one POPCNT per word
+    size_t total = 0;
+    if (mask) {
+        for (size_t i = 0; i < count; ++i) total += popcount(words[i] & mask[i]);
+    } else {
+        for (size_t i = 0; i < count; ++i) total += popcount(words[i]);
+    }
+    return total;
+}
+#endif
+
+
+// Function to select the tasks whose status a filter allows
+uint64_t completionMask(const TaskFilter& filter, uint64_t completed) {
+    // Precondition: 'completed' is a word of the completion bitmap.
+    // Post condition: Returns the word with a bit set for every one of its 64 tasks whose status lies in the
+    //                 filter's range.
+
+    uint64_t mask = ~uint64_t(0);
+    if (filter.minCompleted > 0) mask &= completed;
+    if (filter.maxCompleted < 1) mask &= ~completed;
+    return mask;
+}
+
+
+// Function to mark the tasks a filter matches
+void filterTasks(const TaskFilter& filter, vector<uint64_t>& selection) {
+    // Precondition: The task columns are built.
+    // Post condition: Bit i % 64 of selection[i / 64] is set exactly if task i matches 'filter'.
+
+    static const FilterKernel kernel = chooseFilterKernel();
+    size_t count = taskColumns.dueDays.size();
+    selection.assign((count + 63) / 64, 0);
+    runInParallel((count + FILTER_BLOCK_TASKS - 1) / FILTER_BLOCK_TASKS, [&](size_t piece) {
+        size_t first = piece * FILTER_BLOCK_TASKS;
+        kernel(taskColumns.dueDays.data() + first, taskColumns.priorities.data() + first, taskColumns.completed.data() + first / 64,
+               min(FILTER_BLOCK_TASKS, count - first), filter, selection.data() + first / 64);
+    });
+}
+
+
+// Function to pick the filter kernel
+FilterKernel chooseFilterKernel() {
+    // Precondition: None
+    // Post condition: Returns the AVX2 kernel if this build has it and the processor supports it, else the SSE2
+    //                 kernel if this build has it, else the plain one.
+
+#ifdef USE_AVX2
+    if (__builtin_cpu_supports("avx2")) return filterBlocksAvx2;
+#endif
+#ifdef USE_SSE2
+    return filterBlocksSse2;
+#else
+    return filterBlocksScalar;
+#endif
+}
+
+
+// Function to filter tasks one at a time
+void filterBlocksScalar(const uint32_t* dueDays, const uint8_t* priorities, const uint64_t* completed, size_t count,
+                        const TaskFilter& filter, uint64_t* selection) {
+    // Precondition: The arrays hold 'count' tasks and 'selection' has room for a bit per task.
+    // Post condition: Bit i % 64 of selection[i / 64] is set exactly if task i matches 'filter'.
+
+    for (size_t word = 0; word * 64 < count; ++word) {
+        uint64_t bits = 0;
+        size_t end = min(count, word * 64 + 64);
+        for (size_t i = word * 64; i < end; ++i) {
+            // '&' rather than '&&' keeps the loop free of branches
+            bool match = (dueDays[i] >= filter.firstDay) & (dueDays[i] <= filter.lastDay) &
+                         (priorities[i] >= filter.minPriority) & (priorities[i] <= filter.maxPriority);
+            bits |= uint64_t(match) << (i % 64);
+        }
+        selection[word] = bits & completionMask(filter, completed[word]);
+    }
+}
+
+
+#ifdef USE_SSE2
+// Function to filter tasks sixteen at a time with SSE2
+void filterBlocksSse2(const uint32_t* dueDays, const uint8_t* priorities, const uint64_t* completed, size_t count,
+                      const TaskFilter& filter, uint64_t* selection) {
+    // Precondition: As for filterBlocksScalar.
+    // Post condition: As for filterBlocksScalar.
+
+    // A byte lies in a range if the range's ends do not move it under max and min. SSE2 compares only signed
+    // 32-bit numbers, so the days are flipped in their top bit first, which keeps their order
+    const __m128i topBit = _mm_set1_epi32(INT_MIN);
+    const __m128i firstDay = _mm_set1_epi32(static_cast<int32_t>(filter.firstDay ^ 0x80000000u));
+    const __m128i lastDay = _mm_set1_epi32(static_cast<int32_t>(filter.lastDay ^ 0x80000000u));
+    const __m128i minPriority = _mm_set1_epi8(static_cast<char>(filter.minPriority));
+    const __m128i maxPriority = _mm_set1_epi8(static_cast<char>(filter.maxPriority));
+    size_t whole = count / 64 * 64;
+    for (size_t base = 0; base < whole; base += 64) {
+        uint64_t bits = 0;
+        for (size_t group = 0; group < 64; group += 16) {
+            size_t i = base + group;
+            __m128i priority = _mm_loadu_si128(reinterpret_cast<const __m128i*>(priorities + i));
+            __m128i inside = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(priority, minPriority), priority),
+                                           _mm_cmpeq_epi8(_mm_min_epu8(priority, maxPriority), priority));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(inside));
+            for (int quarter = 0; quarter < 4; ++quarter) {
+                __m128i day = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(dueDays + i + quarter * 4)), topBit);
+                __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(firstDay, day), _mm_cmpgt_epi32(day, lastDay));
+                mask &= ~(static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(outside))) << (quarter * 4));
+            }
+            bits |= uint64_t(mask) << group;
+        }
+        selection[base / 64] = bits & completionMask(filter, completed[base / 64]);
+    }
+    if (whole < count) {
+        filterBlocksScalar(dueDays + whole, priorities + whole, completed + whole / 64, count - whole, filter, selection + whole / 64);
+    }
+}
+#endif
+
+
+#ifdef USE_AVX2
+// Function to filter tasks thirty-two at a time with AVX2
+__attribute__((target("avx2")))
+void filterBlocksAvx2(const uint32_t* dueDays, const uint8_t* priorities, const uint64_t* completed, size_t count,
+                      const TaskFilter& filter, uint64_t* selection) {
+    // Precondition: As for filterBlocksScalar; the processor supports AVX2.
+    // Post condition: As for filterBlocksScalar.
+
+    // The same range test as filterBlocksSse2, but AVX2 has unsigned 32-bit max and min, so the days need no flip
+    const __m256i firstDay = _mm256_set1_epi32(static_cast<int32_t>(filter.firstDay));
+    const __m256i lastDay = _mm256_set1_epi32(static_cast<int32_t>(filter.lastDay));
+    const __m256i minPriority = _mm256_set1_epi8(static_cast<char>(filter.minPriority));
+    const __m256i maxPriority = _mm256_set1_epi8(static_cast<char>(filter.maxPriority));
+    size_t whole = count / 64 * 64;
+    for (size_t base = 0; base < whole; base += 64) {
+        uint64_t bits = 0;
+        for (size_t group = 0; group < 64; group += 32) {
+            size_t i = base + group;
+            __m256i priority = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(priorities + i));
+            __m256i inside = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(priority, minPriority), priority),
+                                              _mm256_cmpeq_epi8(_mm256_min_epu8(priority, maxPriority), priority));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(inside));
+            uint32_t dayMask = 0;
+            for (int quarter = 0; quarter < 4; ++quarter) {
+                __m256i day = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dueDays + i + quarter * 8));
+                __m256i dayInside = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(day, firstDay), day),
+                                                     _mm256_cmpeq_epi32(_mm256_min_epu32(day, lastDay), day));
+                dayMask |= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(dayInside))) << (quarter * 8);
+            }
+            bits |= uint64_t(mask & dayMask) << group;
+        }
+        selection[base / 64] = bits & completionMask(filter, completed[base / 64]);
+    }
+    if (whole < count) {
+        filterBlocksScalar(dueDays + whole, priorities + whole, completed + whole / 64, count - whole, filter, selection + whole / 64);
+    }
+}
+#endif
+
+
+// Function to parse a filter query into a flat program
+bool compileQuery(string_view text, TaskQuery& query, string& error) {
+    // Precondition: None
+    // Post condition: Returns true and fills 'query' if 'text' is a valid query; otherwise returns false and sets
+    //                 'error' to the reason. Words are read in any case.
+    //
+    // query      := and-terms { "or" and-terms }
+    // and-terms  := term { "and" term }
+    // term       := "not" term | "(" query ")" | "done" | "pending" | field comparison value
+    // field      := "priority" (a number) | "due" (YYYY-MM-DD or "today")
+    // comparison := "=" | "==" | "!=" | "<" | "<=" | ">" | ">="
+
+    string lowered(text);
+    for (char& c : lowered) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    query = TaskQuery();
+    QueryParser parser;
+    parser.text = lowered;
+    parser.query = &query;
+    bool parsed = parseQueryOr(parser, false);
+    if (parsed) {
+        string_view extra = nextQueryToken(parser);
+        if (!extra.empty()) {
+            parser.error = extra == ")" ? "unmatched ')'" : "expected 'and' or 'or' before '" + string(extra) + "'";
+            parsed = false;
+        }
+    }
+    if (!parsed) {
+        error = parser.error;
+        query = TaskQuery();
+    }
+    return parsed;
+}
+
+
+// Function to compile the terms of a query joined by 'or'
+bool parseQueryOr(QueryParser& parser, bool negate) {
+    // Precondition: 'parser' is at the start of a query.
+    // Post condition: Returns true and appends the program of the query, negated if 'negate' is set, if it parses;
+    //                 otherwise returns false and sets the parser's error.
+
+    if (!parseQueryAnd(parser, negate)) return false;
+    size_t end;
+    while (peekQueryToken(parser, end) == "or") {
+        parser.position = end;
+        if (!parseQueryAnd(parser, negate)) return false;
+        emitQueryStep(*parser.query, negate ? QUERY_AND : QUERY_OR);  // not (a or b) is (not a) and (not b)
+    }
+    return true;
+}
+
+
+// Function to compile the terms of a query joined by 'and'
+bool parseQueryAnd(QueryParser& parser, bool negate) {
+    // Precondition: 'parser' is at the start of a term.
+    // Post condition: As for parseQueryOr, for terms joined by 'and'.
+
+    if (!parseQueryTerm(parser, negate)) return false;
+    size_t end;
+    while (peekQueryToken(parser, end) == "and") {
+        parser.position = end;
+        if (!parseQueryTerm(parser, negate)) return false;
+        emitQueryStep(*parser.query, negate ? QUERY_OR : QUERY_AND);  // not (a and b) is (not a) or (not b)
+    }
+    return true;
+}
+
+
+// Function to compile one term of a query
+bool parseQueryTerm(QueryParser& parser, bool negate) {
+    // Precondition: 'parser' is at the start of a term.
+    // Post condition: As for parseQueryOr, for one comparison, status word, 'not' or parenthesized query.
+
+    string_view token = nextQueryToken(parser);
+    if (token == "not" || token == "(") {
+        // The parser recurses here, so the nesting is capped to keep the stack small
+        if (parser.nesting == MAX_QUERY_NESTING) {
+            parser.error = "the query is nested too deeply";
+            return false;
+        }
+        ++parser.nesting;
+        bool parsed = token == "not" ? parseQueryTerm(parser, !negate) : parseQueryOr(parser, negate);
+        --parser.nesting;
+        if (parsed && token == "(" && nextQueryToken(parser) != ")") {
+            parser.error = "missing ')'";
+            parsed = false;
+        }
+        return parsed;
+    }
+    if (token == "done" || token == "pending") {
+        TaskFilter test;
+        test.minCompleted = test.maxCompleted = (token == "done") != negate;
+        emitQueryTest(*parser.query, test);
+        return true;
+    }
+    if (token != "priority" && token != "due") {
+        parser.error = token.empty() ? "the query ends too early" : "unknown word '" + string(token) + "'";
+        return false;
+    }
+
+    bool isDue = token == "due";
+    string_view comparison = nextQueryToken(parser);
+    if (comparison != "=" && comparison != "==" && comparison != "!=" && comparison != "<" && comparison != "<="
+        && comparison != ">" && comparison != ">=") {
+        parser.error = "expected =, !=, <, <=, > or >= after '" + string(token) + "'";
+        return false;
+    }
+    string_view value = nextQueryToken(parser);
+    int64_t number = 0;
+    if (isDue) {
+        if (value == "today") number = today();
+        else if (isValidDate(value)) number = dayNumber(value);
+        else {
+            parser.error = "'" + string(value) + "' is not a date; use YYYY-MM-DD or today";
+            return false;
+        }
+    } else {
+        auto [end, error] = from_chars(value.data(), value.data() + value.size(), number);
+        if (value.empty() || error != errc() || end != value.data() + value.size()) {
+            parser.error = "'" + string(value) + "' is not a number";
+            return false;
+        }
+        number = clamp<int64_t>(number, INT32_MIN, INT32_MAX);  // Keeps number + 1 from overflowing below
+    }
+
+    // The comparison as a range of the field's valid values; a malformed due date lies outside every range, so it
+    // matches no comparison, negated or not
+    int64_t lowest = isDue ? 1 : MIN_PRIORITY;
+    int64_t highest = isDue ? UINT32_MAX : MAX_PRIORITY;
+    int64_t first = lowest;
+    int64_t last = highest;
+    if (comparison == "<") last = number - 1;
+    else if (comparison == "<=") last = number;
+    else if (comparison == ">") first = number + 1;
+    else if (comparison == ">=") first = number;
+    else first = last = number;
+    if (comparison == "!=") negate = !negate;
+    first = max(first, lowest);
+    last = min(last, highest);
+    bool empty = first > last;
+    if (empty) {
+        // A range with no valid values, kept inside the field's bounds so it survives the narrowing to a TaskFilter
+        first = highest;
+        last = lowest - 1;
+    }
+    if (!negate) {
+        emitQueryRange(*parser.query, isDue, first, last);
+    } else if (empty) {
+        emitQueryRange(*parser.query, isDue, lowest, highest);
+    } else {
+        // What lies outside the range: the values below it, those above it, both or none
+        bool below = first > lowest;
+        bool above = last < highest;
+        if (below) emitQueryRange(*parser.query, isDue, lowest, first - 1);
+        if (above) emitQueryRange(*parser.query, isDue, last + 1, highest);
+        if (below && above) emitQueryStep(*parser.query, QUERY_OR);
+        if (!below && !above) emitQueryRange(*parser.query, isDue, highest, lowest - 1);
+    }
+    return true;
+}
+
+
+// Function to return the next token of a query without taking it
+string_view peekQueryToken(const QueryParser& parser, size_t& end) {
+    // Precondition: None
+    // Post condition: Returns the next word, number, date, comparison or other character of the query, or an empty
+    //                 view at the end; 'end' is the offset just past it.
+
+    string_view text = parser.text;
+    size_t start = parser.position;
+    while (start < text.size() && isspace(static_cast<unsigned char>(text[start]))) ++start;
+    end = start;
+    auto isWordByte = [](char c) { return isalnum(static_cast<unsigned char>(c)) || c == '-'; };
+    if (end == text.size()) return text.substr(end, 0);
+    if (isWordByte(text[end])) {
+        while (end < text.size() && isWordByte(text[end])) ++end;  // Words, numbers and dates
+    } else if (end + 1 < text.size() && text[end + 1] == '=' && strchr("<>!=", text[end]) != nullptr) {
+        end += 2;
+    } else {
+        ++end;
+    }
+    return text.substr(start, end - start);
+}
+
+
+// Function to take the next token of a query
+string_view nextQueryToken(QueryParser& parser) {
+    // Precondition: None
+    // Post condition: Returns the next token as peekQueryToken does and moves the parser past it.
+
+    size_t end;
+    string_view token = peekQueryToken(parser, end);
+    parser.position = end;
+    return token;
+}
+
+
+// Function to add a test of a due day or priority range to a query
+void emitQueryRange(TaskQuery& query, bool isDue, int64_t first, int64_t last) {
+    // Precondition: 'first' and 'last' lie from one below the field's lowest valid value to its highest.
+    // Post condition: The query pushes the tasks whose due day, or priority, lies from 'first' to 'last'.
+
+    TaskFilter test;
+    if (isDue) {
+        test.firstDay = static_cast<uint32_t>(first);
+        test.lastDay = static_cast<uint32_t>(last);
+    } else {
+        test.minPriority = static_cast<uint8_t>(first);
+        test.maxPriority = static_cast<uint8_t>(last);
+    }
+    emitQueryTest(query, test);
+}
+
+
+// Function to add a range test to a query
+void emitQueryTest(TaskQuery& query, const TaskFilter& test) {
+    // Precondition: None
+    // Post condition: The query pushes the tasks that match 'test'.
+
+    query.program.push_back({QUERY_TEST, static_cast<uint32_t>(query.tests.size())});
+    query.tests.push_back(test);
+}
+
+
+// Function to add an AND or OR to a query
+void emitQueryStep(TaskQuery& query, QueryOp op) {
+    // Precondition: The program pushes at least two results.
+    // Post condition: The query combines its top two results with 'op'. An AND of two tests becomes one test of the
+    //                 ranges both allow.
+
+    vector<QueryStep>& program = query.program;
+    size_t size = program.size();
+    if (op == QUERY_AND && program[size - 1].op == QUERY_TEST && program[size - 2].op == QUERY_TEST) {
+        // A test is a whole operand, so these two are the operands; the last one is also the last test added
+        TaskFilter& left = query.tests[program[size - 2].test];
+        const TaskFilter& right = query.tests.back();
+        left.firstDay = max(left.firstDay, right.firstDay);
+        left.lastDay = min(left.lastDay, right.lastDay);
+        left.minPriority = max(left.minPriority, right.minPriority);
+        left.maxPriority = min(left.maxPriority, right.maxPriority);
+        left.minCompleted = max(left.minCompleted, right.minCompleted);
+        left.maxCompleted = min(left.maxCompleted, right.maxCompleted);
+        query.tests.pop_back();
+        program.pop_back();
+        return;
+    }
+    program.push_back({op});
+}
+
+
+// Function to mark the tasks a compiled query matches
+void runQuery(const TaskQuery& query, vector<uint64_t>& selection) {
+    // Precondition: The task columns are built and 'query' was compiled by compileQuery.
+    // Post condition: Bit i % 64 of selection[i / 64] is set exactly if task i matches 'query'.
+
+    static const FilterKernel kernel = chooseFilterKernel();
+    size_t count = taskColumns.dueDays.size();
+    selection.assign((count + 63) / 64, 0);
+
+    // Tests an index narrows down are answered for the whole list first; the others stay empty and are scanned
+    vector<vector<uint64_t>> answered(query.tests.size());
+    for (size_t t = 0; t < query.tests.size(); ++t) answerFromIndex(query.tests[t], count, answered[t]);
+
+    size_t depth = 0;
+    size_t height = 0;
+    for (const QueryStep& step : query.program) {
+        height = step.op == QUERY_TEST ? height + 1 : height - 1;
+        depth = max(depth, height);
+    }
+
+    runInParallel((count + FILTER_BLOCK_TASKS - 1) / FILTER_BLOCK_TASKS, [&](size_t piece) {
+        size_t first = piece * FILTER_BLOCK_TASKS;
+        size_t blockTasks = min(FILTER_BLOCK_TASKS, count - first);
+        size_t blockWords = (blockTasks + 63) / 64;
+        vector<uint64_t> stack(depth * blockWords);
+        uint64_t* top = stack.data();  // Just past the top result
+        for (const QueryStep& step : query.program) {
+            if (step.op == QUERY_TEST) {
+                const vector<uint64_t>& bits = answered[step.test];
+                if (!bits.empty()) {
+                    copy(bits.begin() + first / 64, bits.begin() + first / 64 + blockWords, top);
+                } else {
+                    kernel(taskColumns.dueDays.data() + first, taskColumns.priorities.data() + first,
+                           taskColumns.completed.data() + first / 64, blockTasks, query.tests[step.test], top);
+                }
+                top += blockWords;
+                continue;
+            }
+            top -= blockWords;
+            uint64_t* left = top - blockWords;
+            if (step.op == QUERY_AND) {
+                for (size_t word = 0; word < blockWords; ++word) left[word] &= top[word];
+            } else {
+                for (size_t word = 0; word < blockWords; ++word) left[word] |= top[word];
+            }
+        }
+        copy(stack.begin(), stack.begin() + blockWords, selection.begin() + first / 64);
+    });
+}
+
+
+// Function to answer a range test from an index
+void answerFromIndex(const TaskFilter& test, size_t count, vector<uint64_t>& bits) {
+    // Precondition: The task columns are built and hold 'count' tasks.
+    // Post condition: If the priority or due date index leaves few enough tasks to check, 'bits' has a bit per
+    //                 task, set exactly if the task matches 'test'; otherwise 'bits' is left empty.
+
+    // Only an index that is already built is used: building one reads every task, which costs more than the scan
+    // it would save. The priority index gives the exact number of tasks in its buckets; the due date index gives
+    // the number of entries in the range, which may include deleted tasks
+    size_t byPriority = SIZE_MAX;
+    size_t byDueDate = SIZE_MAX;
+    int lowest = max<int>(test.minPriority, MIN_PRIORITY);
+    int highest = min<int>(test.maxPriority, MAX_PRIORITY);
+    if (priorityIndex.built) {
+        byPriority = 0;
+        for (int status = test.minCompleted; status <= test.maxCompleted; ++status) {
+            for (int priority = lowest; priority <= highest; ++priority) byPriority += priorityIndex.buckets[status][priority].size();
+        }
+    }
+    uint64_t lowestEntry = uint64_t(test.firstDay) << 32;
+    uint64_t highestEntry = uint64_t(test.lastDay) << 32 | UINT32_MAX;
+    auto dueRange = [&](const vector<uint64_t>& entries) {
+        if (test.firstDay > test.lastDay) return pair(entries.end(), entries.end());
+        return pair(lower_bound(entries.begin(), entries.end(), lowestEntry), upper_bound(entries.begin(), entries.end(), highestEntry));
+    };
+    auto [sortedFirst, sortedLast] = dueRange(dueDateIndex.sorted);
+    auto [recentFirst, recentLast] = dueRange(dueDateIndex.recent);
+    if (dueDateIndex.built) byDueDate = (sortedLast - sortedFirst) + (recentLast - recentFirst);
+
+    size_t candidates = min(byPriority, byDueDate);
+    if (candidates == SIZE_MAX || candidates > count / QUERY_INDEX_RATIO) return;
+    bits.assign((count + 63) / 64, 0);
+    auto check = [&](size_t position) {
+        if (matchesFilter(test, position)) bits[position / 64] |= uint64_t(1) << (position % 64);
+    };
+    if (byPriority <= byDueDate) {
+        for (int status = test.minCompleted; status <= test.maxCompleted; ++status) {
+            for (int priority = lowest; priority <= highest; ++priority) {
+                for (uint32_t position : priorityIndex.buckets[status][priority]) check(position);
+            }
+        }
+    } else {
+        // A deleted task's entry fails the check, since its slot holds DEAD_SLOT_PRIORITY; an entry left behind by
+        // a new due date checks the task's current fields, which its current entry does as well
+        for (auto entry = sortedFirst; entry != sortedLast; ++entry) check(*entry & UINT32_MAX);
+        for (auto entry = recentFirst; entry != recentLast; ++entry) check(*entry & UINT32_MAX);
+    }
+}
+
+
+// Function to test one task of the columns against a filter
+bool matchesFilter(const TaskFilter& filter, size_t position) {
+    // Precondition: 'position' is a position in the task columns.
+    // Post condition: Returns true if the task at 'position' matches 'filter', as the filter kernels decide it.
+
+    uint32_t day = taskColumns.dueDays[position];
+    uint8_t priority = taskColumns.priorities[position];
+    uint8_t completed = (taskColumns.completed[position / 64] >> (position % 64)) & 1;
+    return day >= filter.firstDay && day <= filter.lastDay && priority >= filter.minPriority && priority <= filter.maxPriority
+        && completed >= filter.minCompleted && completed <= filter.maxCompleted;
+}
+
+
+// Function to add a title to a bloom filter
+void addTitleToBloom(vector<uint8_t>& bloom, string_view title, vector<size_t>* touched) {
+    // Precondition: 'bloom' is not empty.
+    // Post condition: The bits for 'title' are set; the byte positions holding them are appended to 'touched' if given.
+
+    uint64_t hash = hashTitle(title);
+    uint64_t step = (hash >> 32) | 1;
+    uint64_t bits = uint64_t(bloom.size()) * 8;
+    for (uint32_t probe = 0; probe < TITLE_BLOOM_PROBES; ++probe) {
+        uint64_t bit = (hash + probe * step) % bits;
+        bloom[bit / 8] |= static_cast<uint8_t>(1 << (bit % 8));
+        if (touched) touched->push_back(bit / 8);
+    }
+}
+
+
+// Function to test a title against a bloom filter
+bool bloomMayContain(const vector<uint8_t>& bloom, uint64_t hash) {
+    // Precondition: 'hash' is the hashTitle hash of the title.
+    // Post condition: Returns false only if the title was never added to 'bloom'; an empty filter rules nothing out.
+
+    if (bloom.empty()) return true;
+    uint64_t step = (hash >> 32) | 1;
+    uint64_t bits = uint64_t(bloom.size()) * 8;
+    for (uint32_t probe = 0; probe < TITLE_BLOOM_PROBES; ++probe) {
+        uint64_t bit = (hash + probe * step) % bits;
+        if (!(bloom[bit / 8] & (1 << (bit % 8)))) return false;
+    }
+    return true;
+}
+
+
+// Function to load tasks at startup
+void loadTasksFromFile(CowVector<Task>& tasks) {
+    // Precondition: None. Missing files simply leave the list empty.
+    // Post condition: The shard index is read and the journal is replayed, or kept until the shards are loaded.
+    //                 Without shards, "tasks.bin" (or else "tasks.txt") is imported and written out as shards.
+    //                 The journal is then opened for appending.
+
+    // Only the index is read here, so the menu appears just as fast however long the list is
+    if (loadShardIndex()) {
+        replayJournal(tasks);
+        openJournal();
+        return;
+    }
+
+    bool imported = loadTasksFromBinaryFile(tasks, BINARY_TASKS_FILE);
+    if (!imported) {
+        loadTasksFromTextFile(tasks, TEXT_TASKS_FILE);
+        imported = !tasks.empty();
+    }
+    regroupShards(tasks);  // No task is in a shard yet
+    replayJournal(tasks);
+    openJournal();
+
+    // Move imported tasks into shards straight away, so later runs never depend on the old files
+    if (imported) compactJournal(tasks);
+}
+
+
+// Function to import tasks from the single binary task file of earlier versions
+bool loadTasksFromBinaryFile(CowVector<Task>& tasks, const string& fileName) {
+    // Precondition: 'fileName' names a file written by an earlier version of saveTasksToFile, or does not exist.
+    // Post condition: Returns true and appends the tasks if the file was loaded, otherwise returns false and leaves 'tasks' unchanged.
+
+    TaskFileContents contents;
+    if (!readTaskFile(fileName, contents)) return false;
+
+    // Keep saving in the compressed format unless the command line says otherwise
+    if (contents.compressed && !compressionChosen) compressSnapshots = true;
+    lastJournalSeq = contents.journalSeq;
+    for (Task& task : contents.tasks) tasks.push_back(move(task));
+    keepTitleStorage(contents);
+    return true;
+}
+
+
+// Function to read a task file of any version
+bool readTaskFile(const string& fileName, TaskFileContents& contents) {
+    // Precondition: 'fileName' names a binary or compressed task file, or does not exist. 'contents' is empty.
+    // Post condition: Returns true and fills 'contents' if the file was read; the titles point into 'contents.mapping'
+    //                 or 'contents.blocks'. Returns false, with nothing left mapped, if the file is missing or damaged.
+
+    MappedFile file;
+    if (!mapFile(fileName, file)) return false;  // No such file
+
+    if (file.size >= sizeof(COMPRESSED_FILE_MAGIC) && memcmp(file.data, COMPRESSED_FILE_MAGIC, sizeof(COMPRESSED_FILE_MAGIC)) == 0) {
+        return readCompressedTaskFile(fileName, file, contents);
+    }
+
+    // Version 1 headers are only 32 bytes long, so a short file is read into a zeroed header
+    BinaryFileHeader header = {};
+    bool valid = file.size >= V1_HEADER_BYTES;
+    if (valid) {
+        memcpy(&header, file.data, min(file.size, sizeof(header)));
+        valid = memcmp(header.magic, BINARY_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                header.version >= 1 && header.version <= BINARY_FILE_VERSION;
+    }
+
+    // Work out where every column starts and check that all of them fit inside the file before touching them
+    size_t count = valid ? header.taskCount : 0;
+    BinaryLayout layout = {};
+    const uint64_t* titleOffsets = nullptr;  // Version 1 title offsets
+    const TitleRef* titleRefs = nullptr;     // Title refs of later versions
+    if (valid && header.version == 1) {
+        layout.titleRefs = V1_HEADER_BYTES;
+        layout.priorities = layout.titleRefs + (count + 1) * sizeof(uint64_t);
+        layout.completion = layout.priorities + count * sizeof(int32_t);
+        layout.dueDates = layout.completion + count;
+        layout.titleHeap = layout.dueDates + count * DUE_DATE_LENGTH;
+        valid = count < file.size && layout.titleHeap <= file.size && header.capacity == file.size - layout.titleHeap;
+        titleOffsets = reinterpret_cast<const uint64_t*>(file.data + layout.titleRefs);
+        valid = valid && titleOffsets[0] == 0 && titleOffsets[count] == header.capacity;
+        for (size_t i = 0; valid && i < count; ++i) valid = titleOffsets[i] <= titleOffsets[i + 1];
+    } else if (valid) {
+        valid = file.size >= FILE_PAGE_BYTES && header.capacity < file.size && count <= header.capacity;
+        if (valid) layout = binaryLayout(header.capacity, header.version);
+        valid = valid && layout.titleHeap <= header.titleHeapEnd && header.titleHeapEnd <= file.size;
+        titleRefs = reinterpret_cast<const TitleRef*>(file.data + layout.titleRefs);
+        for (size_t i = 0; valid && i < count; ++i) {
+            valid = titleRefs[i].offset >= layout.titleHeap && titleRefs[i].offset <= header.titleHeapEnd &&
+                    titleRefs[i].length <= header.titleHeapEnd - titleRefs[i].offset;
+        }
+    }
+    if (!valid) {
+        cout << fileName << " is damaged or was written by a newer version and was not loaded." << endl;
+        unmapFile(file);
+        return false;
+    }
+
+    // Build the tasks straight from the columns; no field needs to be parsed and the titles stay in the mapping
+    const int32_t* priorities = reinterpret_cast<const int32_t*>(file.data + layout.priorities);
+    contents.tasks.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        Task& task = contents.tasks[i];
+        if (titleRefs) task.title = string_view(file.data + titleRefs[i].offset, titleRefs[i].length);
+        else task.title = string_view(file.data + layout.titleHeap + titleOffsets[i], titleOffsets[i + 1] - titleOffsets[i]);
+        task.dueDay = dayNumber(string_view(file.data + layout.dueDates + i * DUE_DATE_LENGTH, DUE_DATE_LENGTH));
+        task.priority = clampPriority(priorities[i]);
+        task.completed = file.data[layout.completion + i] != 0;
+    }
+    contents.journalSeq = header.journalSeq;
+
+    // A current file records positions and a title filter, and can take later changes in place
+    if (header.version == BINARY_FILE_VERSION) {
+        contents.positions.resize(count);
+        memcpy(contents.positions.data(), file.data + layout.positions, count * sizeof(uint32_t));
+        contents.titleBloom.assign(file.data + layout.titleBloom, file.data + layout.titleBloom + header.capacity);
+        contents.state.updatable = true;
+        contents.state.taskCount = count;
+        contents.state.capacity = header.capacity;
+        contents.state.titleHeapEnd = header.titleHeapEnd;
+        contents.state.garbageBytes = header.garbageBytes;
+    }
+    contents.mapping = move(file);  // The titles point into the mapping
+    return true;
+}
+
+
+// Function to write a compressed task file holding all tasks of a shard
+bool writeCompressedShard(Shard& shard, SaveJob& job, uint64_t generation) {
+    // Precondition: 'shard' is a copy, held by 'job', of a shard with at least one task.
+    // Post condition: Returns true if a new compressed file numbered 'generation' was written; 'shard' then describes
+    //                 it and its old file is added to the job's retired files. The new file only counts once the index is written.
+
+    const CowVector<Task>& tasks = job.tasks;
+
+    // Due dates repeat heavily, so each distinct date is stored once and tasks refer to it by number
+    const vector<uint32_t>& members = shard.members;
+    vector<uint32_t> dateCodes(members.size());
+    unordered_map<uint32_t, uint32_t> dateNumbers;
+    string dictionary;
+    vector<uint8_t> bloom(max<size_t>(8, members.size()), 0);
+    for (size_t i = 0; i < members.size(); ++i) {
+        uint32_t day = tasks[members[i]].dueDay;
+        auto found = dateNumbers.find(day);
+        if (found == dateNumbers.end()) {
+            found = dateNumbers.emplace(day, static_cast<uint32_t>(dateNumbers.size())).first;
+            char date[DUE_DATE_LENGTH];
+            formatDay(day, date);
+            dictionary.append(date, DUE_DATE_LENGTH);
+        }
+        dateCodes[i] = found->second;
+        addTitleToBloom(bloom, tasks[members[i]].title, nullptr);
+    }
+
+    // Lay out and compress every block on its own thread
+    size_t blockCount = (members.size() + COMPRESSED_BLOCK_TASKS - 1) / COMPRESSED_BLOCK_TASKS;
+    vector<vector<char>> packed(blockCount);
+    vector<CompressedBlockInfo> blocks(blockCount);
+    runInParallel(blockCount, [&](size_t b) {
+        size_t first = b * COMPRESSED_BLOCK_TASKS;
+        size_t count = min(COMPRESSED_BLOCK_TASKS, members.size() - first);
+        size_t titleBytes = 0;
+        for (size_t i = first; i < first + count; ++i) titleBytes += tasks[members[i]].title.size();
+
+        vector<char> raw(count * (4 * sizeof(uint32_t) + 1) + titleBytes);
+        char* codes = raw.data();
+        char* priorities = codes + count * sizeof(uint32_t);
+        char* lengths = priorities + count * sizeof(int32_t);
+        char* positions = lengths + count * sizeof(uint32_t);
+        char* completion = positions + count * sizeof(uint32_t);
+        char* titles = completion + count;
+        memcpy(codes, &dateCodes[first], count * sizeof(uint32_t));
+        memcpy(positions, &members[first], count * sizeof(uint32_t));
+        for (size_t i = 0; i < count; ++i) {
+            const Task& task = tasks[members[first + i]];
+            int32_t priority = task.priority;
+            uint32_t length = static_cast<uint32_t>(task.title.size());
+            memcpy(priorities + i * sizeof(int32_t), &priority, sizeof(priority));
+            memcpy(lengths + i * sizeof(uint32_t), &length, sizeof(length));
+            completion[i] = task.completed ? 1 : 0;
+            memcpy(titles, task.title.data(), length);
+            titles += length;
+        }
+
+        lzCompress(raw.data(), raw.size(), packed[b]);
+        blocks[b].compressedSize = static_cast<uint32_t>(packed[b].size());
+        blocks[b].rawSize = static_cast<uint32_t>(raw.size());
+        blocks[b].taskCount = static_cast<uint32_t>(count);
+    });
+
+    CompressedFileHeader header = {};
+    memcpy(header.magic, COMPRESSED_FILE_MAGIC, sizeof(header.magic));
+    header.version = COMPRESSED_FILE_VERSION;
+    header.taskCount = members.size();
+    header.journalSeq = job.journalSeq;
+    header.blockCount = static_cast<uint32_t>(blockCount);
+    header.dateCount = static_cast<uint32_t>(dateNumbers.size());
+    header.bloomBytes = bloom.size();
+
+    uint64_t bloomOffset = sizeof(header) + dictionary.size() + blockCount * sizeof(CompressedBlockInfo);
+    uint64_t offset = bloomOffset + bloom.size();
+    for (CompressedBlockInfo& block : blocks) {
+        block.offset = offset;
+        offset += block.compressedSize;
+    }
+
+    vector<char> buffer;
+    buffer.reserve(offset);
+    const char* headerBytes = reinterpret_cast<const char*>(&header);
+    const char* blockBytes = reinterpret_cast<const char*>(blocks.data());
+    buffer.insert(buffer.end(), headerBytes, headerBytes + sizeof(header));
+    buffer.insert(buffer.end(), dictionary.begin(), dictionary.end());
+    buffer.insert(buffer.end(), blockBytes, blockBytes + blockCount * sizeof(CompressedBlockInfo));
+    buffer.insert(buffer.end(), bloom.begin(), bloom.end());
+    for (const vector<char>& block : packed) buffer.insert(buffer.end(), block.begin(), block.end());
+
+    if (!writeFileAtomically(shardFileName(shard.month, generation), buffer.data(), buffer.size())) return false;
+    if (shard.generation != 0) job.retiredFiles.push_back(shardFileName(shard.month, shard.generation));
+
+    shard.generation = generation;
+    shard.storedCount = members.size();
+    shard.bloomOffset = bloomOffset;
+    shard.bloomBytes = bloom.size();
+    shard.titleBloom = move(bloom);
+    shard.rewrite = false;
+    shard.file = SnapshotState();  // A compressed file cannot be updated in place
+    return true;
+}
+
+
+// Function to read a compressed task file
+bool readCompressedTaskFile(const string& fileName, MappedFile& file, TaskFileContents& contents) {
+    // Precondition: 'file' holds 'fileName', which starts with the compressed file signature.
+    // Post condition: Returns true and fills 'contents' if the file is intact, otherwise returns false.
+    //                 The mapping is released either way, since the titles live in the unpacked blocks.
+
+    // Version 1 headers are 32 bytes long and have no bloom filter
+    CompressedFileHeader header = {};
+    bool valid = file.size >= COMPRESSED_V1_HEADER_BYTES;
+    if (valid) {
+        memcpy(&header, file.data, min(file.size, sizeof(header)));
+        valid = header.version == 1 || header.version == COMPRESSED_FILE_VERSION;
+    }
+    if (valid && header.version == 1) header.bloomBytes = 0;
+    size_t columnCount = header.version == 1 ? 3 : 4;  // uint32_t-sized entries per task in an unpacked block
+
+    // Check the dictionary, directory and block sizes before unpacking anything
+    uint64_t dictionaryStart = header.version == 1 ? COMPRESSED_V1_HEADER_BYTES : sizeof(header);
+    uint64_t directoryStart = dictionaryStart + uint64_t(header.dateCount) * DUE_DATE_LENGTH;
+    uint64_t bloomStart = directoryStart + uint64_t(header.blockCount) * sizeof(CompressedBlockInfo);
+    uint64_t blocksStart = bloomStart + header.bloomBytes;
+    valid = valid && dictionaryStart <= file.size && header.bloomBytes <= file.size && blocksStart <= file.size;
+    vector<CompressedBlockInfo> blocks(valid ? header.blockCount : 0);
+    vector<size_t> firstTask(blocks.size() + 1, 0);
+    if (valid) memcpy(blocks.data(), file.data + directoryStart, blocks.size() * sizeof(CompressedBlockInfo));
+    for (size_t b = 0; valid && b < blocks.size(); ++b) {
+        const CompressedBlockInfo& block = blocks[b];
+        valid = block.offset >= blocksStart && block.offset <= file.size && block.compressedSize <= file.size - block.offset &&
+                block.taskCount <= COMPRESSED_BLOCK_TASKS && block.rawSize >= block.taskCount * (columnCount * sizeof(uint32_t) + 1);
+        firstTask[b + 1] = firstTask[b] + block.taskCount;
+    }
+    valid = valid && firstTask.back() == header.taskCount;
+    if (!valid) {
+        cout << fileName << " is damaged or was written by a newer version and was not loaded." << endl;
+        unmapFile(file);
+        return false;
+    }
+
+    vector<uint32_t> dates(header.dateCount);
+    for (size_t d = 0; d < dates.size(); ++d) dates[d] = dayNumber(string_view(file.data + dictionaryStart + d * DUE_DATE_LENGTH, DUE_DATE_LENGTH));
+    contents.titleBloom.assign(file.data + bloomStart, file.data + blocksStart);
+
+    // Unpack the blocks in parallel; every block fills its own slice of the list
+    contents.tasks.resize(header.taskCount);
+    if (header.version != 1) contents.positions.resize(header.taskCount);
+    vector<unique_ptr<char[]>> raw(blocks.size());
+    atomic<bool> intact(true);
+    runInParallel(blocks.size(), [&](size_t b) {
+        const CompressedBlockInfo& block = blocks[b];
+        raw[b] = make_unique<char[]>(block.rawSize);
+        if (!lzDecompress(file.data + block.offset, block.compressedSize, raw[b].get(), block.rawSize)) {
+            intact = false;
+            return;
+        }
+
+        size_t count = block.taskCount;
+        const char* codes = raw[b].get();
+        const char* priorities = codes + count * sizeof(uint32_t);
+        const char* lengths = priorities + count * sizeof(int32_t);
+        const char* positions = lengths + count * sizeof(uint32_t);
+        const char* completion = positions + (columnCount - 3) * count * sizeof(uint32_t);
+        const char* titles = completion + count;
+        const char* end = raw[b].get() + block.rawSize;
+        if (!contents.positions.empty()) memcpy(&contents.positions[firstTask[b]], positions, count * sizeof(uint32_t));
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t code, length;
+            int32_t priority;
+            memcpy(&code, codes + i * sizeof(uint32_t), sizeof(code));
+            memcpy(&priority, priorities + i * sizeof(int32_t), sizeof(priority));
+            memcpy(&length, lengths + i * sizeof(uint32_t), sizeof(length));
+            if (code >= dates.size() || length > static_cast<size_t>(end - titles)) {
+                intact = false;
+                return;
+            }
+            Task& task = contents.tasks[firstTask[b] + i];
+            task.title = string_view(titles, length);
+            task.dueDay = dates[code];
+            task.priority = clampPriority(priority);
+            task.completed = completion[i] != 0;
+            titles += length;
+        }
+    });
+    unmapFile(file);
+
+    if (!intact) {
+        contents = TaskFileContents();
+        cout << fileName << " is damaged and was not loaded." << endl;
+        return false;
+    }
+    contents.blocks = move(raw);  // The titles point into the blocks
+    contents.journalSeq = header.journalSeq;
+    contents.compressed = true;
+    return true;
+}
+
+
+// Function to keep the memory behind the titles of a file for the rest of the run
+void keepTitleStorage(TaskFileContents& contents) {
+    // Precondition: 'contents' was filled in by readTaskFile.
+    // Post condition: The mapping and unpacked blocks of 'contents' are owned by the global title storage.
+
+    if (contents.mapping.data) mappedFiles.push_back(move(contents.mapping));
+    for (unique_ptr<char[]>& block : contents.blocks) unpackedBlocks.push_back(move(block));
+    contents.mapping = MappedFile();
+    contents.blocks.clear();
+}
+
+
+// Function to compress a block of bytes with a small LZ77 coder
+void lzCompress(const char* data, size_t size, vector<char>& out) {
+    // Precondition: None
+    // Post condition: The compressed form of the 'size' bytes at 'data' is appended to 'out'.
+
+    // The output is a series of sequences: a token byte (literal count in the high nibble, match length minus
+    // LZ_MIN_MATCH in the low nibble), extra length bytes for a literal count of 15 or more, the literals,
+    // a two-byte match offset and extra length bytes for a match nibble of 15. The last sequence has no match.
+    auto putLength = [&out](size_t length) {
+        for (; length >= 255; length -= 255) out.push_back(static_cast<char>(255));
+        out.push_back(static_cast<char>(length));
+    };
+    auto putLiterals = [&](size_t from, size_t to, size_t matchCode) {
+        size_t count = to - from;
+        out.push_back(static_cast<char>((min<size_t>(count, 15) << 4) | min<size_t>(matchCode, 15)));
+        if (count >= 15) putLength(count - 15);
+        out.insert(out.end(), data + from, data + to);
+    };
+
+    vector<uint32_t> lastSeen(size_t(1) << LZ_HASH_BITS, 0);  // Position + 1 of the last 4-byte sequence with each hash
+    size_t anchor = 0;
+    size_t position = 0;
+    while (position + LZ_MIN_MATCH <= size) {
+        uint32_t sequence;
+        memcpy(&sequence, data + position, sizeof(sequence));
+        uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t candidate = lastSeen[hash];
+        lastSeen[hash] = static_cast<uint32_t>(position + 1);
+        if (candidate == 0 || position - (candidate - 1) > LZ_MAX_OFFSET || memcmp(data + candidate - 1, data + position, LZ_MIN_MATCH) != 0) {
+            ++position;
+            continue;
+        }
+
+        size_t match = candidate - 1;
+        size_t length = LZ_MIN_MATCH;
+        while (position + length < size && data[match + length] == data[position + length]) ++length;
+
+        size_t matchCode = length - LZ_MIN_MATCH;
+        putLiterals(anchor, position, matchCode);
+        uint16_t offset = static_cast<uint16_t>(position - match);
+        out.push_back(static_cast<char>(offset & 0xFF));
+        out.push_back(static_cast<char>(offset >> 8));
+        if (matchCode >= 15) putLength(matchCode - 15);
+        position += length;
+        anchor = position;
+    }
+    putLiterals(anchor, size, 0);
+}
+
+
+// Function to unpack a block made by lzCompress
+bool lzDecompress(const char* data, size_t size, char* out, size_t outSize) {
+    // Precondition: 'out' has room for 'outSize' bytes.
+    // Post condition: Returns true if the input unpacked to exactly 'outSize' bytes; false if it is damaged.
+
+    size_t in = 0;
+    size_t produced = 0;
+    auto getLength = [&](size_t& length) {
+        for (;;) {
+            if (in >= size) return false;
+            uint8_t extra = static_cast<uint8_t>(data[in++]);
+            length += extra;
+            if (extra != 255) return true;
+        }
+    };
+
+    while (in < size) {
+        uint8_t token = static_cast<uint8_t>(data[in++]);
+        size_t literals = token >> 4;
+        if (literals == 15 && !getLength(literals)) return false;
+        if (literals > size - in || literals > outSize - produced) return false;
+        memcpy(out + produced, data + in, literals);
+        in += literals;
+        produced += literals;
+        if (in == size) break;  // The last sequence carries no match
+
+        if (size - in < 2) return false;
+        size_t offset = static_cast<uint8_t>(data[in]) | (static_cast<size_t>(static_cast<uint8_t>(data[in + 1])) << 8);
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !getLength(length)) return false;
+        length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > produced || length > outSize - produced) return false;
+
+        // Copy byte by byte, since a match may overlap the bytes it is producing
+        const char* source = out + produced - offset;
+        for (size_t i = 0; i < length; ++i) out[produced + i] = source[i];
+        produced += length;
+    }
+    return produced == outSize;
+}
+
+
+// Function to run body(0) to body(count - 1) spread over all cores
+void runInParallel(size_t count, const function<void(size_t)>& body) {
+    // Precondition: Calls of 'body' for different indices may run at the same time safely.
+    // Post condition: Every index has been processed when the function returns.
+
+    size_t threadCount = min<size_t>(max(1u, thread::hardware_concurrency()), count);
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < count; ++i) body(i);
+        return;
+    }
+
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for (size_t t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&] {
+            for (size_t i = next++; i < count; i = next++) body(i);
+        });
+    }
+    for (thread& worker : workers) worker.join();
+}
+
+
+// Function to import tasks from the legacy text file
+void loadTasksFromTextFile(CowVector<Task>& tasks, const string& fileName) {
+    // Precondition: The file must exist and be accessible for reading, with four lines per task.
+    // Post condition: All tasks from the file are appended to the 'tasks' vector in file order.
+
+    MappedFile file;
+    if (!mapFile(fileName, file)) return;  // If the file cannot be opened, exit the function
+
+    // Split the file into one byte range per thread; small files are parsed on a single thread
+    size_t threadCount = max<size_t>(1, thread::hardware_concurrency());
+    threadCount = min(threadCount, file.size / MIN_PARSE_CHUNK_BYTES + 1);
+    vector<size_t> bounds(threadCount + 1);
+    for (size_t t = 0; t <= threadCount; ++t) bounds[t] = file.size * t / threadCount;
+
+    // First pass: count the lines in every range, so each thread knows the line number it starts at
+    vector<uint64_t> firstLine(threadCount + 1, 0);
+    runInParallel(threadCount, [&](size_t t) {
+        firstLine[t + 1] = static_cast<uint64_t>(count(file.data + bounds[t], file.data + bounds[t + 1], '\n'));
+    });
+    for (size_t t = 0; t < threadCount; ++t) firstLine[t + 1] += firstLine[t];
+
+    // Second pass: every thread parses the records that start inside its range into its own vector
+    vector<vector<Task>> parsed(threadCount);
+    runInParallel(threadCount, [&](size_t t) {
+        parseTextRecords(file.data, file.size, bounds[t], bounds[t + 1], firstLine[t], parsed[t]);
+    });
+
+    // Splice the per-thread results together in their original order
+    for (vector<Task>& part : parsed) {
+        for (Task& task : part) tasks.push_back(move(task));
+    }
+    mappedFiles.push_back(move(file));  // The titles point into the file, so it stays mapped
+}
+
+
+// Function to parse the four-line text records that start inside a byte range
+void parseTextRecords(const char* data, size_t size, size_t begin, size_t end, uint64_t lineIndex, vector<Task>& out) {
+    // Precondition: 'lineIndex' is the number of newlines before byte 'begin' of the 'size' bytes at 'data'.
+    // Post condition: Every complete record whose title line starts in [begin, end) is appended to 'out'.
+
+    // Returns the line starting at 'position' (without its line break) and moves 'position' to the next line
+    auto nextLine = [data, size](size_t& position) {
+        const char* start = data + position;
+        const char* newline = static_cast<const char*>(memchr(start, '\n', size - position));
+        size_t length = newline ? static_cast<size_t>(newline - start) : size - position;
+        position += newline ? length + 1 : length;
+        if (length > 0 && start[length - 1] == '\r') --length;  // Files written on Windows end lines with CRLF
+        return string_view(start, length);
+    };
+
+    // Move to the first line that starts in the range, then to the first line that begins a record
+    size_t position = begin;
+    if (position > 0 && data[position - 1] != '\n') {
+        const char* newline = static_cast<const char*>(memchr(data + position, '\n', size - position));
+        position = newline ? static_cast<size_t>(newline - data) + 1 : size;
+        ++lineIndex;
+    }
+    while (lineIndex % 4 != 0 && position < end) {
+        nextLine(position);
+        ++lineIndex;
+    }
+
+    while (position < end && position < size) {
+        string_view title = nextLine(position);
+        if (position >= size) break;  // A title with nothing after it is not a complete record
+        string_view dueDate = nextLine(position);
+        string_view priorityText = nextLine(position);
+        string_view completedText = nextLine(position);
+
+        Task task;
+        int priority;
+        while (!priorityText.empty() && isspace(static_cast<unsigned char>(priorityText.front()))) priorityText.remove_prefix(1);
+        if (from_chars(priorityText.data(), priorityText.data() + priorityText.size(), priority).ec != errc()) {
+            continue;  // Skip records cut short or without a number in the priority line
+        }
+        task.title = title;
+        task.dueDay = dayNumber(dueDate);
+        task.priority = clampPriority(priority);
+        task.completed = !completedText.empty() && completedText.front() == '1';
+        out.push_back(move(task));
+    }
+}
+
+
+// Function to add the tasks of a CSV or NDJSON file to the list
+void importTasks(CowVector<Task>& tasks, const string& fileName) {
+    // Precondition: 'tasksMutex' is held.
+    // Post condition: Every valid record whose title is not taken yet is appended to 'tasks' in file order and the
+    //                 shards are saved. Rejected records are counted and the first few are reported by line.
+
+    ExchangeFormat format;
+    if (!exchangeFormat(fileName, format)) return;
+    MappedFile file;
+    if (!mapFile(fileName, file)) {
+        cout << "Could not open " << fileName << "." << endl;
+        return;
+    }
+    auto started = chrono::steady_clock::now();
+
+    // Skip a UTF-8 byte order mark and, for CSV, a header naming the columns
+    size_t start = file.size >= 3 && memcmp(file.data, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    CsvColumns columns;
+    if (format == FORMAT_CSV && !readCsvHeader(file.data, file.size, start, columns)) {
+        unmapFile(file);
+        return;
+    }
+
+    // Split the records into one byte range per thread; small files are parsed on a single thread
+    size_t threadCount = max<size_t>(1, thread::hardware_concurrency());
+    threadCount = min(threadCount, (file.size - start) / MIN_PARSE_CHUNK_BYTES + 1);
+    vector<size_t> bounds(threadCount + 1);
+    for (size_t t = 0; t <= threadCount; ++t) bounds[t] = start + (file.size - start) * t / threadCount;
+
+    // A CSV line break inside quotes does not end a record, and a quote is only special at the start of a field or
+    // inside a quoted one, so counting quotes cannot tell where a range starts. Each range is followed from every
+    // state it could start in, which the ranges before it then settle in order
+    vector<uint8_t> startStates(threadCount, CSV_RECORD_START);
+    if (format == FORMAT_CSV && threadCount > 1) {
+        vector<array<uint8_t, CSV_SCAN_STATES>> endStates(threadCount);
+        runInParallel(threadCount, [&](size_t t) {
+            for (uint8_t state = 0; state < CSV_SCAN_STATES; ++state) endStates[t][state] = state;
+            scanCsvStates(file.data, bounds[t], bounds[t + 1], endStates[t].data());
+        });
+        for (size_t t = 1; t < threadCount; ++t) startStates[t] = endStates[t - 1][startStates[t - 1]];
+    }
+
+    // Every thread parses and checks the records that start inside its range
+    vector<ImportBatch> batches(threadCount);
+    runInParallel(threadCount, [&](size_t t) {
+        if (format == FORMAT_CSV) parseCsvRecords(file.data, file.size, bounds[t], bounds[t + 1], startStates[t], columns, batches[t]);
+        else parseJsonRecords(file.data, file.size, bounds[t], bounds[t + 1], t == 0, batches[t]);
+    });
+
+    // Each range must pick up just where the records of the ranges before it stopped. Bytes between them would be
+    // lost without a word, so they are counted as a problem
+    size_t resume = start;
+    for (ImportBatch& batch : batches) {
+        if (format != FORMAT_CSV || batch.firstRecord == SIZE_MAX) continue;
+        if (batch.firstRecord != resume) {
+            ++batch.invalid;
+            batch.problems.insert(batch.problems.begin(), {resume, "records were lost between parsing threads"});
+            if (batch.problems.size() > MAX_REPORTED_PROBLEMS) batch.problems.pop_back();
+        }
+        resume = batch.recordsEnd;
+    }
+
+    // Titles must stay unique, as addTask requires, both against the list and within the file. The title index
+    // answers both once each new task is indexed as it is appended
+    ensureTasksLoaded(tasks);
+    ensureTitleIndex(tasks);
+    size_t parsedCount = 0;
+    for (const ImportBatch& batch : batches) parsedCount += batch.tasks.size();
+    reserveTitleIndex(tasks, titleIndex.count + parsedCount);
+    dueDateIndex.built = false;  // Sorting everything again beats merging the delta buffer over and over
+
+    // Append the new tasks in file order
+    size_t added = 0;
+    size_t duplicates = 0;
+    size_t invalid = 0;
+    size_t reported = 0;
+    for (ImportBatch& batch : batches) {
+        for (size_t i = 0; i < batch.tasks.size(); ++i) {
+            if (i + TITLE_PREFETCH_DISTANCE < batch.tasks.size()) prefetchTitleSlot(batch.titleHashes[i + TITLE_PREFETCH_DISTANCE]);
+            if (findTitle(tasks, batch.tasks[i].title, batch.titleHashes[i]) != NO_TASK) {
+                ++duplicates;
+                continue;
+            }
+            appendTask(tasks, move(batch.tasks[i]), batch.titleHashes[i]);
+            ++added;
+        }
+        invalid += batch.invalid;
+        for (const ImportProblem& problem : batch.problems) {
+            if (reported == MAX_REPORTED_PROBLEMS) break;
+            ++reported;
+            size_t line = countByte(file.data, file.data + problem.offset, '\n') + 1;
+            cout << fileName << ", line " << line << ": " << problem.reason << "." << endl;
+        }
+
+        // Keep the title copies; they go before the arena's current block, which stays the one being filled
+        titleArena.blocks.insert(titleArena.blocks.end() - (titleArena.blocks.empty() ? 0 : 1),
+                                 make_move_iterator(batch.arena.blocks.begin()), make_move_iterator(batch.arena.blocks.end()));
+    }
+    unmapFile(file);  // Every title was copied, so the file may change as soon as the import is done
+    unsavedChanges += added;
+
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started);
+    cout << "Imported " << added << (added == 1 ? " task" : " tasks") << " from " << fileName << " in " << elapsed.count()
+         << " ms; skipped " << duplicates << " duplicate title" << (duplicates == 1 ? "" : "s") << " and " << invalid
+         << " invalid record" << (invalid == 1 ? "" : "s") << "." << endl;
+    if (added > 0) compactJournal(tasks);  // The imported tasks are not journaled, so save them straight away
+}
+
+
+// Function to write all tasks to a CSV or NDJSON file
+void exportTasks(CowVector<Task>& tasks, const string& fileName) {
+    // Precondition: 'tasksMutex' is held.
+    // Post condition: 'fileName' holds every task in list order, or is left as it was if it could not be written.
+
+    ExchangeFormat format;
+    if (!exchangeFormat(fileName, format)) return;
+    ensureTasksLoaded(tasks);
+
+    // Every thread formats a contiguous share of the list into its own buffer
+    size_t threadCount = min<size_t>(max(1u, thread::hardware_concurrency()), tasks.size() / MIN_THREAD_TASKS + 1);
+    vector<string> parts(threadCount);
+    runInParallel(threadCount, [&](size_t t) {
+        size_t first = tasks.size() * t / threadCount;
+        size_t last = tasks.size() * (t + 1) / threadCount;
+        parts[t].reserve((last - first) * 64);
+        for (size_t i = first; i < last; ++i) {
+            if (isDeadSlot(i)) continue;
+            if (format == FORMAT_CSV) appendCsvTask(tasks[i], parts[t]);
+            else appendJsonTask(tasks[i], parts[t]);
+        }
+    });
+
+    string out = format == FORMAT_CSV ? "title,dueDate,priority,completed\n" : "";
+    size_t total = out.size();
+    for (const string& part : parts) total += part.size();
+    out.reserve(total);
+    for (const string& part : parts) out += part;
+    if (!writeFileAtomically(fileName, out.data(), out.size())) {
+        cout << "Failed to write " << fileName << "." << endl;
+        return;
+    }
+    size_t count = countTasks(tasks);
+    cout << "Exported " << count << (count == 1 ? " task" : " tasks") << " to " << fileName << "." << endl;
+}
+
+
+// Function to pick the exchange format from a file name
+bool exchangeFormat(const string& fileName, ExchangeFormat& format) {
+    // Precondition: None
+    // Post condition: Returns true and sets 'format' for a .csv, .ndjson or .jsonl file; otherwise reports it and returns false.
+
+    string extension = filesystem::path(fileName).extension().string();
+    for (char& c : extension) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    if (extension == ".csv") {
+        format = FORMAT_CSV;
+    } else if (extension == ".ndjson" || extension == ".jsonl") {
+        format = FORMAT_NDJSON;
+    } else {
+        cout << "Cannot tell the format of " << fileName << "; use a .csv, .ndjson or .jsonl file." << endl;
+        return false;
+    }
+    return true;
+}
+
+
+// Function to read the column names of a CSV file
+bool readCsvHeader(const char* data, size_t size, size_t& position, CsvColumns& columns) {
+    // Precondition: 'position' is the start of the first record of the 'size' bytes at 'data'.
+    // Post condition: If the first record names the columns, 'columns' follows it and 'position' is moved past it;
+    //                 otherwise the columns keep the order title,dueDate,priority,completed. Returns false, after
+    //                 reporting it, if the header lacks a column every task needs.
+
+    if (position >= size) return true;
+    size_t next = position;
+    vector<string_view> fields;
+    TitleArena arena;  // Only needed for names with escaped quotes
+    splitCsvRecord(data, size, next, fields, arena);
+    if (fields.empty()) return true;
+
+    // Names are matched ignoring case, spaces and underscores, so "Due Date" and "due_date" both work
+    auto columnName = [](string_view field) {
+        string name;
+        for (char c : field) {
+            if (c != ' ' && c != '_' && c != '\t') name += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+        return name;
+    };
+    string first = columnName(fields[0]);
+    if (first != "title" && first != "duedate" && first != "priority" && first != "completed") return true;  // No header
+
+    columns = {-1, -1, -1, -1};
+    for (size_t i = 0; i < fields.size(); ++i) {
+        string name = columnName(fields[i]);
+        int column = static_cast<int>(i);
+        if (name == "title") columns.title = column;
+        else if (name == "duedate") columns.dueDate = column;
+        else if (name == "priority") columns.priority = column;
+        else if (name == "completed") columns.completed = column;
+    }
+    if (columns.title < 0 || columns.dueDate < 0 || columns.priority < 0) {
+        cout << "The header of the CSV file needs title, dueDate and priority columns." << endl;
+        return false;
+    }
+    position = next;
+    return true;
+}
+
+
+// Function to parse the CSV records that start inside a byte range
+void parseCsvRecords(const char* data, size_t size, size_t begin, size_t end, uint8_t state, const CsvColumns& columns, ImportBatch& batch) {
+    // Precondition: 'state' is the CsvScanState at byte 'begin', as the file read from its first record gives it.
+    // Post condition: Every valid record that starts in [begin, end) is appended to 'batch.tasks' and every other
+    //                 one is counted as a problem. 'batch.firstRecord' and 'batch.recordsEnd' tell which bytes the
+    //                 records covered.
+
+    // Move to the first record that starts in the range. Plain bytes leave the state as the first of them does, so
+    // they are stepped over in one go
+    size_t position = begin;
+    while (position < end && state != CSV_RECORD_START && (state != CSV_AFTER_CR || data[position] == '\n')) {
+        const char* hit = findAnyOf(data + position, data + end, '"', ',', '\n', '\r');
+        if (hit != data + position) {
+            state = nextCsvState(state, 'x');
+            position = static_cast<size_t>(hit - data);
+        } else {
+            state = nextCsvState(state, *hit);
+            ++position;
+        }
+    }
+    if (position < end) batch.firstRecord = position;
+
+    // Lines are counted first, so the tasks are never moved while the vectors grow
+    size_t lines = countByte(data + begin, data + end, '\n') + 1;
+    batch.tasks.reserve(lines);
+    batch.titleHashes.reserve(lines);
+
+    vector<string_view> fields;
+    ImportFields record;
+    auto field = [&fields](int column) { return column >= 0 && column < static_cast<int>(fields.size()) ? fields[column] : string_view(); };
+    while (position < end && position < size) {
+        size_t recordStart = position;
+        bool wellFormed = splitCsvRecord(data, size, position, fields, batch.arena);
+        if (fields.size() == 1 && fields[0].empty()) continue;  // Blank line
+        if (!wellFormed) {
+            addImportProblem(batch, recordStart, "unbalanced quotes");
+            continue;
+        }
+
+        record.title = field(columns.title);
+        record.dueDate = field(columns.dueDate);
+        record.priority = field(columns.priority);
+        record.completed = field(columns.completed);
+        Task task;
+        const char* problem = buildImportedTask(record, batch.arena, task);
+        if (problem) {
+            addImportProblem(batch, recordStart, problem);
+            continue;
+        }
+        batch.titleHashes.push_back(hashTitle(task.title));
+        batch.tasks.push_back(move(task));
+    }
+    batch.recordsEnd = position;
+}
+
+
+// Function to return the CSV scan state after one more byte
+uint8_t nextCsvState(uint8_t state, char byte) {
+    // Precondition: 'state' is a CsvScanState.
+    // Post condition: Returns the state past 'byte', following splitCsvRecord: a quote opens a field only at its
+    //                 start, a doubled quote stays inside it, and a line feed, or a carriage return with or without
+    //                 one, ends a record outside quotes.
+
+    int kind = byte == '"' ? 0 : byte == ',' ? 1 : byte == '\n' ? 2 : byte == '\r' ? 3 : 4;
+    return CSV_TRANSITIONS[state][kind];
+}
+
+
+// Function to follow a byte range of a CSV file from every scan state at once
+void scanCsvStates(const char* data, size_t begin, size_t end, uint8_t* states) {
+    // Precondition: 'states' holds CSV_SCAN_STATES states.
+    // Post condition: Each state is replaced by the state it leads to at byte 'end' when the scan is at it at byte
+    //                 'begin'.
+
+    // Starting states that reach the same state go on as one path, so after a field or two a well-formed file
+    // is followed just once
+    uint8_t paths[CSV_SCAN_STATES];
+    uint8_t pathOf[CSV_SCAN_STATES];
+    size_t pathCount = 0;
+    auto merge = [&] {
+        for (size_t i = pathCount; i-- > 1;) {
+            size_t j = find(paths, paths + i, paths[i]) - paths;
+            if (j == i) continue;
+            --pathCount;
+            paths[i] = paths[pathCount];
+            for (uint8_t& path : pathOf) path = path == i ? j : path == pathCount ? i : path;
+        }
+    };
+    for (size_t s = 0; s < CSV_SCAN_STATES; ++s) {
+        paths[pathCount] = states[s];
+        pathOf[s] = pathCount++;
+    }
+    merge();
+
+    // Only quotes, commas and line breaks tell the states apart; a run of other bytes acts as its first byte
+    const char* position = data + begin;
+    const char* last = data + end;
+    while (position < last) {
+        if (pathCount == 1) {
+            // Outside quotes only a quote changes what the bytes mean, and the byte before it says whether it
+            // opens a field; inside quotes only the next quote matters
+            const char* quote = static_cast<const char*>(memchr(position, '"', static_cast<size_t>(last - position)));
+            const char* hit = quote ? quote : last;
+            if (paths[0] != CSV_QUOTED && hit != position) paths[0] = nextCsvState(CSV_UNQUOTED, hit[-1]);
+            if (!quote) break;
+            paths[0] = nextCsvState(paths[0], '"');
+            position = quote + 1;
+            continue;
+        }
+        const char* hit = findAnyOf(position, last, '"', ',', '\n', '\r');
+        if (hit != position) {
+            for (size_t p = 0; p < pathCount; ++p) paths[p] = CSV_TRANSITIONS[paths[p]][4];
+        }
+        if (hit == last) break;
+        for (size_t p = 0; p < pathCount; ++p) paths[p] = nextCsvState(paths[p], *hit);
+        if (pathCount > 1) merge();
+        position = hit + 1;
+    }
+    for (size_t s = 0; s < CSV_SCAN_STATES; ++s) states[s] = paths[pathOf[s]];
+}
+
+
+// Function to parse the NDJSON records that start inside a byte range
+void parseJsonRecords(const char* data, size_t size, size_t begin, size_t end, bool atRecord, ImportBatch& batch) {
+    // Precondition: 'begin' is the start of a line if 'atRecord' is true.
+    // Post condition: Every valid record on a line that starts in [begin, end) is appended to 'batch.tasks' and
+    //                 every other one is counted as a problem. Blank lines are skipped.
+
+    // JSON strings cannot hold a raw line break, so every line break ends a record
+    size_t position = begin;
+    if (!atRecord && data[position - 1] != '\n') {
+        const char* newline = static_cast<const char*>(memchr(data + position, '\n', size - position));
+        position = newline ? static_cast<size_t>(newline - data) + 1 : size;
+    }
+
+    size_t lines = countByte(data + begin, data + end, '\n') + 1;
+    batch.tasks.reserve(lines);
+    batch.titleHashes.reserve(lines);
+
+    while (position < end && position < size) {
+        const char* lineStart = data + position;
+        const char* newline = static_cast<const char*>(memchr(lineStart, '\n', size - position));
+        const char* lineEnd = newline ? newline : data + size;
+        position = static_cast<size_t>(lineEnd - data) + (newline ? 1 : 0);
+
+        const char* first = lineStart;
+        while (first < lineEnd && (*first == ' ' || *first == '\t' || *first == '\r')) ++first;
+        if (first == lineEnd) continue;  // Blank line
+
+        ImportFields record;
+        Task task;
+        const char* problem = parseJsonObject(first, lineEnd, record, batch.arena);
+        if (!problem) problem = buildImportedTask(record, batch.arena, task);
+        if (problem) {
+            addImportProblem(batch, static_cast<size_t>(lineStart - data), problem);
+            continue;
+        }
+        batch.titleHashes.push_back(hashTitle(task.title));
+        batch.tasks.push_back(move(task));
+    }
+}
+
+
+// Function to split one CSV record into its fields
+bool splitCsvRecord(const char* data, size_t size, size_t& position, vector<string_view>& fields, TitleArena& arena) {
+    // Precondition: 'position' is the start of a record of the 'size' bytes at 'data'.
+    // Post condition: 'fields' holds the record's fields with quotes removed and 'position' is just past the record.
+    //                 Returns false if a quoted field is never closed or is followed by anything but a delimiter.
+
+    fields.clear();
+    const char* current = data + position;
+    const char* end = data + size;
+    bool wellFormed = true;
+    while (true) {
+        if (current < end && *current == '"') {
+            // A quoted field runs to the next lone quote; a doubled quote stands for one quote character
+            const char* start = ++current;
+            const char* quote = static_cast<const char*>(memchr(current, '"', static_cast<size_t>(end - current)));
+            string unescaped;
+            while (quote && quote + 1 < end && quote[1] == '"') {
+                unescaped.append(current, quote + 1);
+                current = quote + 2;
+                quote = static_cast<const char*>(memchr(current, '"', static_cast<size_t>(end - current)));
+            }
+            if (!quote) {
+                position = size;  // The rest of the file belongs to the unclosed field
+                return false;
+            }
+            if (start == current) {
+                fields.push_back(string_view(start, static_cast<size_t>(quote - start)));
+            } else {
+                unescaped.append(current, quote);
+                fields.push_back(storeTitle(arena, unescaped));
+            }
+            current = quote + 1;
+            if (current < end && *current != ',' && *current != '\n' && *current != '\r') {
+                wellFormed = false;  // Text after the closing quote; skip to the next delimiter
+                current = findAnyOf(current, end, ',', '\n', '\r', ',');
+            }
+        } else {
+            const char* delimiter = findAnyOf(current, end, ',', '\n', '\r', ',');
+            fields.push_back(string_view(current, static_cast<size_t>(delimiter - current)));
+            current = delimiter;
+        }
+
+        if (current < end && *current == ',') {
+            ++current;
+            continue;
+        }
+        if (current < end && *current == '\r') ++current;
+        if (current < end && *current == '\n') ++current;
+        break;
+    }
+    position = static_cast<size_t>(current - data);
+    return wellFormed;
+}
+
+
+// Function to read the fields of one JSON object
+const char* parseJsonObject(const char* position, const char* end, ImportFields& fields, TitleArena& arena) {
+    // Precondition: [position, end) is one line of an NDJSON file.
+    // Post condition: Returns nullptr and fills in the fields named "title", "dueDate", "priority" and "completed"
+    //                 if the line is a flat JSON object; otherwise returns what is wrong with it. Other keys are ignored.
+
+    auto skipSpace = [&position, end] {
+        while (position < end && (*position == ' ' || *position == '\t' || *position == '\r')) ++position;
+    };
+    if (position == end || *position != '{') return "not a JSON object";
+    ++position;
+    skipSpace();
+    if (position < end && *position == '}') {
+        ++position;
+    } else {
+        while (true) {
+            string_view key;
+            string_view value;
+            if (position == end || *position != '"' || !parseJsonString(position, end, key, arena)) return "malformed JSON";
+            skipSpace();
+            if (position == end || *position != ':') return "malformed JSON";
+            ++position;
+            skipSpace();
+            if (position == end) return "malformed JSON";
+            if (*position == '"') {
+                if (!parseJsonString(position, end, value, arena)) return "malformed JSON";
+            } else if (*position == '{' || *position == '[') {
+                return "nested JSON values are not supported";
+            } else {
+                // A number, true, false or null
+                const char* token = position;
+                while (position < end && *position != ',' && *position != '}' && *position != ' ' && *position != '\t' && *position != '\r') ++position;
+                value = string_view(token, static_cast<size_t>(position - token));
+                if (value.empty()) return "malformed JSON";
+                if (value == "null") value = string_view();
+            }
+
+            if (key == "title") fields.title = value;
+            else if (key == "dueDate") fields.dueDate = value;
+            else if (key == "priority") fields.priority = value;
+            else if (key == "completed") fields.completed = value;
+
+            skipSpace();
+            if (position < end && *position == ',') {
+                ++position;
+                skipSpace();
+                continue;
+            }
+            if (position < end && *position == '}') {
+                ++position;
+                break;
+            }
+            return "malformed JSON";
+        }
+    }
+    skipSpace();
+    return position == end ? nullptr : "text after the JSON object";
+}
+
+
+// Function to read one JSON string
+bool parseJsonString(const char*& position, const char* end, string_view& value, TitleArena& arena) {
+    // Precondition: 'position' points at the opening quote of a string that ends before 'end'.
+    // Post condition: Returns true, sets 'value' to the unescaped text and moves 'position' past the closing quote,
+    //                 or returns false if the string is unterminated or has a bad escape.
+
+    // Most strings have no escapes, so they are returned as a view into the file
+    const char* start = ++position;
+    const char* hit = findAnyOf(position, end, '"', '\\', '"', '\\');
+    if (hit == end) return false;
+    if (*hit == '"') {
+        value = string_view(start, static_cast<size_t>(hit - start));
+        position = hit + 1;
+        return true;
+    }
+
+    // Reads four hex digits of a \u escape
+    auto readHex = [&position, end](uint32_t& code) {
+        if (end - position < 4) return false;
+        auto [last, error] = from_chars(position, position + 4, code, 16);
+        if (error != errc() || last != position + 4) return false;
+        position += 4;
+        return true;
+    };
+
+    string text(start, hit);
+    position = hit;
+    while (*position == '\\') {
+        if (++position == end) return false;
+        char escape = *position++;
+        switch (escape) {
+            case '"': case '\\': case '/': text += escape; break;
+            case 'b': text += '\b'; break;
+            case 'f': text += '\f'; break;
+            case 'n': text += '\n'; break;
+            case 'r': text += '\r'; break;
+            case 't': text += '\t'; break;
+            case 'u': {
+                uint32_t code;
+                if (!readHex(code)) return false;
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    // Characters outside the basic plane are written as a pair of surrogates
+                    uint32_t low;
+                    if (end - position < 2 || position[0] != '\\' || position[1] != 'u') return false;
+                    position += 2;
+                    if (!readHex(low) || low < 0xDC00 || low > 0xDFFF) return false;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                    return false;
+                }
+
+                // Store the character as UTF-8
+                if (code < 0x80) {
+                    text += static_cast<char>(code);
+                } else if (code < 0x800) {
+                    text += static_cast<char>(0xC0 | (code >> 6));
+                    text += static_cast<char>(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    text += static_cast<char>(0xE0 | (code >> 12));
+                    text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    text += static_cast<char>(0x80 | (code & 0x3F));
+                } else {
+                    text += static_cast<char>(0xF0 | (code >> 18));
+                    text += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                    text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    text += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: return false;
+        }
+        hit = findAnyOf(position, end, '"', '\\', '"', '\\');
+        if (hit == end) return false;
+        text.append(position, hit);
+        position = hit;
+    }
+    ++position;
+    value = storeTitle(arena, text);
+    return true;
+}
+
+
+// Function to check an imported record and turn it into a task
+const char* buildImportedTask(const ImportFields& fields, TitleArena& arena, Task& task) {
+    // Precondition: None
+    // Post condition: Returns nullptr and fills in 'task', with its title copied into 'arena', if the record passes
+    //                 the same checks as a task typed into addTask; otherwise returns what is wrong with it.
+
+    auto trim = [](string_view text) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+        return text;
+    };
+    if (fields.title.empty()) return "missing title";
+
+    string_view dueDate = trim(fields.dueDate);
+    if (!isValidDate(dueDate)) return "invalid due date";
+
+    string_view priority = trim(fields.priority);
+    const char* priorityEnd = priority.data() + priority.size();
+    int priorityValue;
+    auto [last, error] = from_chars(priority.data(), priorityEnd, priorityValue);
+    if (error != errc() || last != priorityEnd || !isValidPriority(priorityValue)) return "invalid priority";
+    task.priority = static_cast<uint8_t>(priorityValue);
+
+    // The completion status may be missing; spreadsheets tend to write TRUE and FALSE
+    string_view completed = trim(fields.completed);
+    string status;
+    for (char c : completed.substr(0, 5)) status += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    if (completed.size() > 5) return "invalid completion status";
+    if (status.empty() || status == "0" || status == "false" || status == "no") task.completed = false;
+    else if (status == "1" || status == "true" || status == "yes") task.completed = true;
+    else return "invalid completion status";
+
+    task.title = storeTitle(arena, fields.title);
+    task.dueDay = dayNumber(dueDate);
+    return nullptr;
+}
+
+
+// Function to count a rejected record
+void addImportProblem(ImportBatch& batch, size_t offset, const char* reason) {
+    // Precondition: 'offset' is where the record starts in the file.
+    // Post condition: The record is counted; the first few are kept for the report.
+
+    ++batch.invalid;
+    if (batch.problems.size() < MAX_REPORTED_PROBLEMS) batch.problems.push_back({offset, reason});
+}
+
+
+// Function to format a task as a CSV record
+void appendCsvTask(const Task& task, string& out) {
+    // Precondition: None
+    // Post condition: One line of the form title,dueDate,priority,completed is appended to 'out'; a title holding
+    //                 a comma, quote or line break is quoted.
+
+    const char* titleEnd = task.title.data() + task.title.size();
+    if (findAnyOf(task.title.data(), titleEnd, ',', '"', '\n', '\r') == titleEnd) {
+        out += task.title;
+    } else {
+        out += '"';
+        for (char c : string_view(task.title)) {
+            if (c == '"') out += '"';
+            out += c;
+        }
+        out += '"';
+    }
+    char number[16];
+    char* numberEnd = to_chars(number, number + sizeof(number), task.priority).ptr;
+    char dueDate[DUE_DATE_LENGTH];
+    formatDay(task.dueDay, dueDate);
+    out += ',';
+    out.append(dueDate, DUE_DATE_LENGTH);
+    out += ',';
+    out.append(number, numberEnd);
+    out += task.completed ? ",1\n" : ",0\n";
+}
+
+
+// Function to format a task as an NDJSON line
+void appendJsonTask(const Task& task, string& out) {
+    // Precondition: None
+    // Post condition: One JSON object with the task's title, due date, priority and completion status is appended
+    //                 to 'out', followed by a line break.
+
+    // Quotes, backslashes and control characters are escaped; everything else is copied as it is
+    auto appendString = [&out](string_view text) {
+        out += '"';
+        for (char c : text) {
+            unsigned char byte = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (c == '\n') {
+                out += "\\n";
+            } else if (c == '\r') {
+                out += "\\r";
+            } else if (c == '\t') {
+                out += "\\t";
+            } else if (byte < 0x20) {
+                const char* hex = "0123456789abcdef";
+                out += "\\u00";
+                out += hex[byte >> 4];
+                out += hex[byte & 0xF];
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    };
+    char number[16];
+    char* numberEnd = to_chars(number, number + sizeof(number), task.priority).ptr;
+    out += "{\"title\":";
+    appendString(task.title);
+    out += ",\"dueDate\":";
+    char dueDate[DUE_DATE_LENGTH];
+    formatDay(task.dueDay, dueDate);
+    appendString(string_view(dueDate, DUE_DATE_LENGTH));
+    out += ",\"priority\":";
+    out.append(number, numberEnd);
+    out += task.completed ? ",\"completed\":true}\n" : ",\"completed\":false}\n";
+}
+
+
+// Function to find the first of four bytes in a range
+const char* findAnyOf(const char* position, const char* end, char a, char b, char c, char d) {
+    // Precondition: None. Passing the same byte more than once looks for fewer bytes.
+    // Post condition: Returns the first byte in [position, end) equal to one of the four, or 'end' if there is none.
+
+#ifdef USE_SSE2
+    // Compare sixteen bytes at a time; the lowest set bit of the mask is the first match
+    const __m128i byteA = _mm_set1_epi8(a);
+    const __m128i byteB = _mm_set1_epi8(b);
+    const __m128i byteC = _mm_set1_epi8(c);
+    const __m128i byteD = _mm_set1_epi8(d);
+    for (; end - position >= 16; position += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, byteA), _mm_cmpeq_epi8(block, byteB)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(block, byteC), _mm_cmpeq_epi8(block, byteD)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask != 0) return position + countr_zero(mask);
+    }
+#endif
+    for (; position < end; ++position) {
+        char byte = *position;
+        if (byte == a || byte == b || byte == c || byte == d) return position;
+    }
+    return end;
+}
+
+
+// Function to count how often a byte occurs in a range
+size_t countByte(const char* position, const char* end, char byte) {
+    // Precondition: None
+    // Post condition: Returns the number of bytes in [position, end) equal to 'byte'.
+
+    size_t total = 0;
+#ifdef USE_SSE2
+    const __m128i target = _mm_set1_epi8(byte);
+    for (; end - position >= 16; position += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+        total += static_cast<size_t>(popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, target)))));
+    }
+#endif
+    return total + static_cast<size_t>(count(position, end, byte));
+}
+
+
+// Function to map a whole file into memory for reading
+bool mapFile(const string& fileName, MappedFile& file) {
+    // Precondition: 'file' is not currently holding a mapping.
+    // Post condition: Returns true and points 'file' at the contents of the file, or returns false if it cannot be opened.
+
+#ifdef _WIN32
+    ifstream inFile(fileName, ios::binary | ios::ate);
+    if (!inFile) return false;
+    file.buffer.resize(static_cast<size_t>(inFile.tellg()));
+    inFile.seekg(0);
+    inFile.read(file.buffer.data(), static_cast<streamsize>(file.buffer.size()));
+    if (!inFile) return false;
+    file.data = file.buffer.data();
+    file.size = file.buffer.size();
+    return true;
+#else
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+
+    file.size = static_cast<size_t>(info.st_size);
+    if (file.size == 0) {
+        // mmap rejects empty ranges, so an empty file gets an empty view instead
+        file.data = "";
+        close(fd);
+        return true;
+    }
+
+    void* address = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping stays valid after the descriptor is closed
+    if (address == MAP_FAILED) {
+        file.size = 0;
+        return false;
+    }
+    file.data = static_cast<const char*>(address);
+    return true;
+#endif
+}
+
+
+// Function to release a file mapped by mapFile
+void unmapFile(MappedFile& file) {
+    // Precondition: 'file' was filled in by mapFile or is empty.
+    // Post condition: The memory behind 'file' is released and 'file' is empty.
+
+#ifdef _WIN32
+    file.buffer.clear();
+    file.buffer.shrink_to_fit();
+#else
+    if (file.size > 0) munmap(const_cast<char*>(file.data), file.size);
+#endif
+    file.data = nullptr;
+    file.size = 0;
+}
+
+
+// Function to copy a typed or journaled title into the title pool
+TaskTitle storeTitle(string_view title) {
+    // Precondition: No other thread is storing a title.
+    // Post condition: Returns a copy of 'title' that stays valid for the rest of the run: the copy a deleted or
+    //                 retitled task let go if the pool holds one, a new copy with its own handle otherwise.
+
+    TaskTitle pooled = lookUpPooledTitle(title);
+    if (pooled.handle != NO_TITLE_HANDLE || title.empty()) return pooled;
+
+    // The handle is the block above the offset; a block holds at most 64 KiB of titles or a single longer one
+    TitleArena& arena = titlePool.arena;
+    if (arena.capacity - arena.used < title.size() && arena.blocks.size() > UINT16_MAX) {
+        return TaskTitle(storeTitle(titleArena, title));  // The pool has run out of block numbers
+    }
+    string_view copy = storeTitle(arena, title);
+    size_t block = arena.blocks.size() - 1;
+    return TaskTitle(copy, static_cast<uint32_t>(block << 16 | (copy.data() - arena.blocks[block].get())));
+}
+
+
+// Function to find the copy of a title the title pool holds
+TaskTitle lookUpPooledTitle(string_view title) {
+    // Precondition: None
+    // Post condition: Returns the copy of 'title' that a deleted or retitled task let go, with its handle, or
+    //                 'title' itself without a handle if there is none.
+
+    if (titlePool.count == 0) return TaskTitle(title);  // Saves hashing every title of a list that never lets one go
+    const size_t mask = titlePool.slots.size() - 1;
+    for (size_t slot = hashTitle(title) & mask; titlePool.slots[slot] != 0; slot = (slot + 1) & mask) {
+        uint64_t entry = titlePool.slots[slot];
+        if (entry >> 32 != title.size()) continue;
+        uint32_t handle = static_cast<uint32_t>(entry) - 1;
+        const char* copy = titlePool.arena.blocks[handle >> 16].get() + (handle & UINT16_MAX);
+        if (memcmp(copy, title.data(), title.size()) == 0) return TaskTitle(string_view(copy, title.size()), handle);
+    }
+    return TaskTitle(title);
+}
+
+
+// Function to let the title pool reuse the copy of a title no task holds any more
+void poolTitle(const TaskTitle& title) {
+    // Precondition: No other thread is storing a title.
+    // Post condition: If 'title' is a copy in the pool, later stores of the same title return it.
+
+    if (title.handle == NO_TITLE_HANDLE || lookUpPooledTitle(title).handle != NO_TITLE_HANDLE) return;
+    if (titlePool.slots.size() < (titlePool.count + 1) * 2) {
+        // Double the table, hashing the titles again
+        vector<uint64_t> old(max<size_t>(16, titlePool.slots.size() * 2), 0);
+        old.swap(titlePool.slots);
+        const size_t mask = titlePool.slots.size() - 1;
+        for (uint64_t entry : old) {
+            if (entry == 0) continue;
+            uint32_t handle = static_cast<uint32_t>(entry) - 1;
+            string_view copy(titlePool.arena.blocks[handle >> 16].get() + (handle & UINT16_MAX), entry >> 32);
+            size_t slot = hashTitle(copy) & mask;
+            while (titlePool.slots[slot] != 0) slot = (slot + 1) & mask;
+            titlePool.slots[slot] = entry;
+        }
+    }
+    const size_t mask = titlePool.slots.size() - 1;
+    size_t slot = hashTitle(title) & mask;
+    while (titlePool.slots[slot] != 0) slot = (slot + 1) & mask;
+    titlePool.slots[slot] = uint64_t(title.size()) << 32 | (uint64_t(title.handle) + 1);
+    ++titlePool.count;
+}
+
+
+// Function to copy a title into a given title arena
+string_view storeTitle(TitleArena& arena, string_view title) {
+    // Precondition: No other thread is using 'arena'.
+    // Post condition: Returns a copy of 'title' that stays valid as long as the blocks of 'arena' are kept.
+
+    if (title.empty()) return string_view();
+    if (arena.capacity - arena.used < title.size()) {
+        // Start a new block; titles longer than a block get a block of their own
+        arena.capacity = max(TITLE_ARENA_BLOCK_BYTES, title.size());
+        arena.blocks.push_back(make_unique<char[]>(arena.capacity));
+        arena.used = 0;
+    }
+    char* destination = arena.blocks.back().get() + arena.used;
+    memcpy(destination, title.data(), title.size());
+    arena.used += title.size();
+    return string_view(destination, title.size());
+}
+
+
+// Function to replace a file with new contents without ever leaving it half-written
+bool writeFileAtomically(const string& fileName, const char* data, size_t size) {
+    // Precondition: The directory of 'fileName' is writable.
+    // Post condition: Returns true if 'fileName' now holds exactly 'data' on disk. On failure the old file is left untouched.
+
+    // The contents go to a temporary file in large writes and are flushed to disk before the rename,
+    // so after a crash the file holds either the complete old contents or the complete new ones
+    string tempName = fileName + ".tmp";
+#ifdef _WIN32
+    int fd = _open(tempName.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+    if (fd < 0) return false;
+    bool written = true;
+    for (size_t offset = 0; written && offset < size;) {
+        unsigned int chunk = static_cast<unsigned int>(min(size - offset, WRITE_CHUNK_BYTES));
+        int result = _write(fd, data + offset, chunk);
+        written = result > 0;
+        if (written) offset += static_cast<size_t>(result);
+    }
+    written = written && _commit(fd) == 0;
+    written = _close(fd) == 0 && written;
+    if (!written || !MoveFileExA(tempName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        _unlink(tempName.c_str());
+        return false;
+    }
+    return true;
+#else
+    int fd = open(tempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool written = true;
+    for (size_t offset = 0; written && offset < size;) {
+        ssize_t result = write(fd, data + offset, min(size - offset, WRITE_CHUNK_BYTES));
+        written = result > 0;
+        if (written) offset += static_cast<size_t>(result);
+    }
+    written = written && fsync(fd) == 0;
+    written = close(fd) == 0 && written;
+    if (!written || rename(tempName.c_str(), fileName.c_str()) != 0) {
+        unlink(tempName.c_str());
+        return false;
+    }
+
+    // Flush the directory too, so the rename itself survives a power failure
+    error_code error;
+    filesystem::path directory = filesystem::absolute(fileName, error).parent_path();
+    int directoryFd = open(directory.c_str(), O_RDONLY);
+    if (directoryFd >= 0) {
+        fsync(directoryFd);
+        close(directoryFd);
+    }
+    return true;
+#endif
+}
+
+
+// Function to update parts of an existing file in place
+bool patchFile(const string& fileName, const vector<FilePatch>& patches, const FilePatch& commit) {
+    // Precondition: 'fileName' exists and the patches are meaningless to readers until 'commit' is written.
+    // Post condition: Returns true if all patches, and after them 'commit', were written and flushed to disk.
+
+    // Writes every byte of 'data' at 'offset', retrying short writes
+    auto writeAt = [](int fd, uint64_t offset, const char* data, size_t size) {
+        while (size > 0) {
+            size_t chunk = min(size, WRITE_CHUNK_BYTES);
+#ifdef _WIN32
+            long long result = _lseeki64(fd, static_cast<long long>(offset), SEEK_SET) < 0 ? -1 : _write(fd, data, static_cast<unsigned int>(chunk));
+#else
+            ssize_t result = pwrite(fd, data, chunk, static_cast<off_t>(offset));
+#endif
+            if (result <= 0) return false;
+            data += result;
+            size -= static_cast<size_t>(result);
+            offset += static_cast<uint64_t>(result);
+        }
+        return true;
+    };
+
+#ifdef _WIN32
+    int fd = _open(fileName.c_str(), _O_WRONLY | _O_BINARY);
+    auto flush = [](int descriptor) { return _commit(descriptor) == 0; };
+#else
+    int fd = open(fileName.c_str(), O_WRONLY);
+    auto flush = [](int descriptor) { return fsync(descriptor) == 0; };
+#endif
+    if (fd < 0) return false;
+
+    // The patches must be on disk before the commit record that makes them visible
+    bool written = true;
+    for (const FilePatch& patch : patches) {
+        written = written && writeAt(fd, patch.offset, patch.bytes.data(), patch.bytes.size());
+    }
+    written = written && flush(fd);
+    written = written && writeAt(fd, commit.offset, commit.bytes.data(), commit.bytes.size()) && flush(fd);
+#ifdef _WIN32
+    written = _close(fd) == 0 && written;
+#else
+    written = close(fd) == 0 && written;
+#endif
+    return written;
+}
+
+
+// Function to apply a change to the list and append it to the journal
+void commitOperation(CowVector<Task>& tasks, JournalRecord& record) {
+    // Precondition: 'record' describes a valid change for the current list and the journal is open.
+    // Post condition: The change is applied to 'tasks' and logged; the journal is compacted if it has grown too large.
+
+    record.seq = lastJournalSeq + 1;
+    if (shardStore.loaded) {
+        applyJournalRecord(tasks, record);
+    } else {
+        // Only the shard index is loaded; the record is applied with the others once the shards are read
+        shardStore.pendingRecords.push_back(record);
+        if (record.op == JOURNAL_ADD) ++shardStore.taskCount;
+        if (record.op == JOURNAL_DELETE) --shardStore.taskCount;
+        lastJournalSeq = record.seq;
+    }
+
+    vector<char> bytes;
+    encodeJournalRecord(record, bytes);
+    journalFile.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+    journalFile.flush();  // Hand the record to the operating system before reporting success
+    if (!journalFile) cout << "Failed to write to " << journalName << "." << endl;
+
+    if (shardStore.loaded) {
+        ++unsavedChanges;
+        if (autosaveChanges > 0 && unsavedChanges >= autosaveChanges) autosaveWake.notify_all();
+    }
+    if (shardStore.loaded && tombstones.deadCount * TOMBSTONE_COMPACTION_RATIO > tasks.size()) {
+        // Compacting costs a pass over the list, paid once for every list-length / ratio deletes
+        requestCompaction();
+    }
+    if (static_cast<uint64_t>(journalFile.tellp()) >= JOURNAL_COMPACTION_BYTES) {
+        // With autosave running, the thread writes the shards so the menu does not wait for them
+        if (autosaveThread.joinable() && shardStore.loaded) {
+            saveRequested = true;
+            autosaveWake.notify_all();
+        } else {
+            compactJournal(tasks);
+        }
+    }
+}
+
+
+// Function to append a task to the list and to everything that keeps track of it
+void appendTask(CowVector<Task>& tasks, Task task, uint64_t titleHash) {
+    // Precondition: 'titleHash' is hashTitle(task.title).
+    // Post condition: The task is last in 'tasks', placed in its shard, due to be saved and in the built indexes.
+
+    uint32_t key = task.dueDay;
+    tasks.push_back(move(task));
+    size_t position = tasks.size() - 1;
+    addLiveSlot(position);
+    assignTaskId(position);
+    placeTaskInShard(tasks, position);
+    markTaskDirty(position, DIRTY_FIELDS | DIRTY_TITLE);
+    indexTitle(tasks, position, titleHash);
+    indexTrigrams(tasks, position);
+    addTitleToTrie(tasks, position);
+    addToSortedViews(tasks, position);
+    addToStats(tasks[position]);
+    indexDueDate(tasks, position, key);
+    indexPriority(position, tasks[position].priority, tasks[position].completed);
+    storeTaskColumns(position, tasks[position]);
+}
+
+
+// Function to apply a journal record to the list in memory
+// The indexes, task columns, ID map, trie, sorted views and counters are each built the first time something needs
+// them once the shards are loaded; from then on every change reaches them through here, so none is built again
+// unless a change marks it stale.
+void applyJournalRecord(CowVector<Task>& tasks, const JournalRecord& record) {
+    // Precondition: 'record' has been validated against the number of live tasks; its index counts live tasks only.
+    // Post condition: 'tasks' reflects the change and 'lastJournalSeq' is the record's sequence number.
+
+    bool retitled = false;
+    bool redated = false;
+    bool reprioritized = false;
+    size_t slot = record.op == JOURNAL_ADD || record.op == JOURNAL_SORT ? 0 : slotOfTask(record.index);
+    if (record.op == JOURNAL_EDIT || record.op == JOURNAL_DELETE || record.op == JOURNAL_COMPLETE) removeFromStats(tasks[slot]);
+    switch (record.op) {
+        case JOURNAL_ADD:
+            appendTask(tasks, record.task, hashTitle(record.task.title));
+            break;
+        case JOURNAL_EDIT: {
+            // The indexes find a task by its old title and priority, so it leaves them before it changes
+            retitled = tasks[slot].title != record.task.title;
+            redated = tasks[slot].dueDay != record.task.dueDay;
+            if (retitled) {
+                unindexTitle(tasks, slot);
+                retireTrigrams(tasks, slot);
+                removeTitleFromTrie(tasks, slot);
+                poolTitle(tasks[slot].title);  // The old title may come back
+            }
+            reprioritized = tasks[slot].priority != record.task.priority || tasks[slot].completed != record.task.completed;
+            if (reprioritized) unindexPriority(slot, tasks[slot].priority, tasks[slot].completed);
+            Task& task = tasks.edit(slot);
+            if (dueMonth(task.dueDay) != dueMonth(record.task.dueDay)) {
+                // A new month means a new shard, where the whole task is new
+                removeTaskFromShard(slot);
+                task = record.task;
+                placeTaskInShard(tasks, slot);
+                markTaskDirty(slot, DIRTY_FIELDS | DIRTY_TITLE);
+                break;
+            }
+            uint8_t flags = DIRTY_FIELDS;
+            if (task.title != record.task.title) {
+                // The old title becomes dead space in the shard's file, unless it never reached the file
+                SnapshotState& state = shardStore.shards[shardStore.taskShard[slot]].file;
+                uint32_t fileSlot = shardStore.taskSlot[slot];
+                bool storedTitle = fileSlot < state.taskCount && (fileSlot >= state.dirtyFlags.size() || !(state.dirtyFlags[fileSlot] & DIRTY_TITLE));
+                if (storedTitle) state.garbageBytes += task.title.size();
+                flags |= DIRTY_TITLE;
+            }
+            task = record.task;
+            markTaskDirty(slot, flags);
+            break;
+        }
+        case JOURNAL_DELETE:
+            // The task leaves the indexes and its slot is marked dead, so no later task moves. The due date index
+            // skips dead slots instead, and the shard's file keeps the row, which the next index lists as dead
+            unindexTitle(tasks, slot);
+            retireTrigrams(tasks, slot);
+            removeTitleFromTrie(tasks, slot);
+            poolTitle(tasks[slot].title);
+            unindexPriority(slot, tasks[slot].priority, tasks[slot].completed);
+            clearTaskColumns(slot);
+            releaseTaskId(slot);
+            buryTask(slot, tasks.size());
+            shardStore.shards[shardStore.taskShard[slot]].deadRows.push_back(shardStore.taskSlot[slot]);
+            break;
+        case JOURNAL_COMPLETE:
+            if (!tasks[slot].completed) {
+                unindexPriority(slot, tasks[slot].priority, false);
+                indexPriority(slot, tasks[slot].priority, true);
+            }
+            tasks.edit(slot).completed = true;
+            storeTaskColumns(slot, tasks[slot]);
+            markTaskDirty(slot, DIRTY_FIELDS);
+            break;
+        case JOURNAL_SORT: {
+            // Sort records come only from journals replayed before the shards are saved again, so no save is running
+            compactTasks(tasks);  // Dead slots would only be sorted along
+            vector<uint32_t> order;
+            sortTasks(tasks, record.sortKey, record.sortFields, order);
+            moveTaskIds(order);  // The IDs stay with their tasks
+            regroupShards(tasks);  // Nearly every task has moved
+            titleIndex.built = false;  // Nearly every position changes, so the indexes are built afresh when next needed
+            dueDateIndex.built = false;
+            priorityIndex.built = false;
+            taskColumns.built = false;
+            trigramIndex.built = false;
+            titleTrie.built = false;
+            for (SortedView& view : sortedViews) view.built = false;
+            break;
+        }
+    }
+    if (retitled) {
+        indexTitle(tasks, slot, hashTitle(record.task.title));
+        indexTrigrams(tasks, slot);
+        addTitleToTrie(tasks, slot);
+    }
+    if (redated) indexDueDate(tasks, slot, record.task.dueDay);  // The old entry stops counting on its own
+    if (reprioritized) indexPriority(slot, record.task.priority, record.task.completed);
+    if (record.op == JOURNAL_EDIT) storeTaskColumns(slot, record.task);
+    if (record.op == JOURNAL_EDIT || record.op == JOURNAL_COMPLETE) {
+        addToSortedViews(tasks, slot);
+        addToStats(tasks[slot]);
+    }
+    lastJournalSeq = record.seq;
+}
+
+
+// Function to check whether a slot of the list holds a deleted task
+bool isDeadSlot(size_t slot) {
+    // Precondition: 'slot' is a slot of 'tasks'.
+    // Post condition: Returns true if the task in the slot was deleted and the list has not been compacted since.
+
+    return tombstones.deadCount > 0 && !(tombstones.live[slot / 64] >> (slot % 64) & 1);
+}
+
+
+// Function to find the slot of a live task
+size_t slotOfTask(size_t index) {
+    // Precondition: 'index' is less than the number of live tasks.
+    // Post condition: Returns the slot of the live task shown as number index + 1.
+
+    if (tombstones.deadCount == 0) return index;
+
+    // Walk down the Fenwick tree to the word holding the task, then skip the live slots before it in the word
+    const vector<uint32_t>& sums = tombstones.sums;
+    size_t word = 0;
+    for (size_t step = bit_floor(sums.size() - 1); step > 0; step >>= 1) {
+        if (word + step < sums.size() && sums[word + step] <= index) {
+            word += step;
+            index -= sums[word];
+        }
+    }
+    uint64_t bits = tombstones.live[word];
+    for (; index > 0; --index) bits &= bits - 1;
+    return word * 64 + countr_zero(bits);
+}
+
+
+// Function to find the index of the live task in a slot
+size_t taskIndex(size_t slot) {
+    // Precondition: 'slot' is a slot of 'tasks'.
+    // Post condition: Returns the number of live tasks before the slot, which is the task's number less one.
+
+    if (tombstones.deadCount == 0) return slot;
+    size_t index = 0;
+    for (size_t node = slot / 64; node > 0; node &= node - 1) index += tombstones.sums[node];
+    return index + popcount(tombstones.live[slot / 64] & ((uint64_t(1) << (slot % 64)) - 1));
+}
+
+
+// Function to mark a slot of the list dead
+void buryTask(size_t slot, size_t slotCount) {
+    // Precondition: 'slot' is a live slot of a list with 'slotCount' slots.
+    // Post condition: The slot is dead. The first dead slot sets up the bitmap and the Fenwick tree.
+
+    vector<uint64_t>& live = tombstones.live;
+    vector<uint32_t>& sums = tombstones.sums;
+    if (tombstones.deadCount == 0) {
+        live.assign((slotCount + 63) / 64, UINT64_MAX);
+        if (slotCount % 64 != 0) live.back() = (uint64_t(1) << (slotCount % 64)) - 1;
+        sums.assign(live.size() + 1, 0);
+        for (size_t node = 1; node < sums.size(); ++node) {
+            sums[node] += popcount(live[node - 1]);
+            size_t parent = node + (node & ~(node - 1));
+            if (parent < sums.size()) sums[parent] += sums[node];
+        }
+    }
+    live[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+    for (size_t node = slot / 64 + 1; node < sums.size(); node += node & ~(node - 1)) --sums[node];
+    ++tombstones.deadCount;
+}
+
+
+// Function to mark a slot appended to the list live
+void addLiveSlot(size_t slot) {
+    // Precondition: 'slot' is the last slot of the list, just appended.
+    // Post condition: The slot is live in the bitmap and the Fenwick tree. Nothing happens while no slot is dead.
+
+    if (tombstones.deadCount == 0) return;
+    vector<uint64_t>& live = tombstones.live;
+    vector<uint32_t>& sums = tombstones.sums;
+    if (slot % 64 == 0) {
+        // A new word gets a new node, which starts with the sums of the nodes it covers
+        live.push_back(0);
+        size_t node = live.size();
+        sums.push_back(0);
+        for (size_t child = 1; child < (node & ~(node - 1)); child <<= 1) sums[node] += sums[node - child];
+    }
+    live[slot / 64] |= uint64_t(1) << (slot % 64);
+    for (size_t node = slot / 64 + 1; node < sums.size(); node += node & ~(node - 1)) ++sums[node];
+}
+
+
+// Function to drop the dead slots from the list
+void compactTasks(CowVector<Task>& tasks) {
+    // Precondition: The shards are loaded.
+    // Post condition: 'tasks' holds only its live tasks, in the same order. Nothing happens while no slot is dead.
+
+    if (tombstones.deadCount == 0) return;
+    installCompactedTasks(tasks, liveTasks(tasks, tombstones.live));
+}
+
+
+// Function to copy the live tasks of a list
+CowVector<Task> liveTasks(const CowVector<Task>& tasks, const vector<uint64_t>& live) {
+    // Precondition: 'live' is the live bitmap of 'tasks'. Only the arguments are used, so this may run without 'tasksMutex'.
+    // Post condition: Returns the tasks whose slots are live, in list order.
+
+    CowVector<Task> compacted;
+    for (size_t word = 0; word < live.size(); ++word) {
+        for (uint64_t bits = live[word]; bits != 0; bits &= bits - 1) compacted.push_back(tasks[word * 64 + countr_zero(bits)]);
+    }
+    return compacted;
+}
+
+
+// Function to replace the list with its compacted copy
+void installCompactedTasks(CowVector<Task>& tasks, CowVector<Task> compacted) {
+    // Precondition: 'compacted' holds the live tasks of 'tasks' in order.
+    // Post condition: 'tasks' is 'compacted' and no slot is dead; everything that refers to slots is rebuilt when
+    //                 next needed and the next save rewrites the shards whose tasks moved.
+
+    vector<uint32_t> order;
+    order.reserve(compacted.size());
+    for (size_t word = 0; word < tombstones.live.size(); ++word) {
+        for (uint64_t bits = tombstones.live[word]; bits != 0; bits &= bits - 1) order.push_back(static_cast<uint32_t>(word * 64 + countr_zero(bits)));
+    }
+    moveTaskIds(order);
+    compactShards(order);
+    tasks = move(compacted);
+    tombstones = Tombstones();
+    titleIndex.built = false;
+    dueDateIndex.built = false;
+    priorityIndex.built = false;
+    taskColumns.built = false;
+    trigramIndex.built = false;
+    titleTrie.built = false;
+    for (SortedView& view : sortedViews) view.built = false;
+}
+
+
+// Function to build the task ID map
+void ensureTaskIds(const CowVector<Task>& tasks) {
+    // Precondition: The shards are loaded.
+    // Post condition: Every live task has an ID; the IDs follow the list order.
+
+    if (taskIds.built) return;
+    taskIds.entries.clear();
+    taskIds.entryOfSlot.assign(tasks.size(), NO_ID);
+    taskIds.freeEntries.clear();
+    taskIds.built = true;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (!isDeadSlot(i)) assignTaskId(i);
+    }
+}
+
+
+// Function to hand out an ID to a task
+void assignTaskId(size_t slot) {
+    // Precondition: The task in 'slot' has no ID; it is the last task of the list unless the map is being built.
+    // Post condition: The task has the ID of a free entry, or of a new one. Nothing happens while the map is not built.
+
+    if (!taskIds.built) return;
+    uint32_t entry;
+    if (taskIds.freeEntries.empty()) {
+        entry = static_cast<uint32_t>(taskIds.entries.size());
+        taskIds.entries.push_back({NO_ID, 0});
+    } else {
+        entry = taskIds.freeEntries.back();
+        taskIds.freeEntries.pop_back();
+    }
+    taskIds.entries[entry].slot = static_cast<uint32_t>(slot);
+    if (slot == taskIds.entryOfSlot.size()) taskIds.entryOfSlot.push_back(entry);
+    else taskIds.entryOfSlot[slot] = entry;
+}
+
+
+// Function to retire the ID of a deleted task
+void releaseTaskId(size_t slot) {
+    // Precondition: The task in 'slot' has an ID.
+    // Post condition: The entry is free under its next generation, so the ID no longer resolves. Nothing happens
+    //                 while the map is not built.
+
+    if (!taskIds.built) return;
+    uint32_t entry = taskIds.entryOfSlot[slot];
+    taskIds.entries[entry].slot = NO_ID;
+    ++taskIds.entries[entry].generation;
+    taskIds.freeEntries.push_back(entry);
+    taskIds.entryOfSlot[slot] = NO_ID;
+}
+
+
+// Function to follow the tasks to their new slots
+void moveTaskIds(const vector<uint32_t>& order) {
+    // Precondition: Slot i of the list is about to hold the task now at 'order[i]'; every slot left out is dead.
+    // Post condition: Every ID resolves to its task's new slot. Nothing happens while the map is not built.
+
+    if (!taskIds.built) return;
+    vector<uint32_t> entryOfSlot(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        entryOfSlot[i] = taskIds.entryOfSlot[order[i]];
+        taskIds.entries[entryOfSlot[i]].slot = static_cast<uint32_t>(i);
+    }
+    taskIds.entryOfSlot = move(entryOfSlot);
+}
+
+
+// Function to return the ID of a task
+uint64_t taskId(size_t slot) {
+    // Precondition: The task ID map is built and 'slot' is live.
+    // Post condition: Returns the task's ID.
+
+    uint32_t entry = taskIds.entryOfSlot[slot];
+    return uint64_t(taskIds.entries[entry].generation) << 32 | entry;
+}
+
+
+// Function to return the ID of a task as the menu shows it
+string taskIdText(size_t slot) {
+    // Precondition: The task ID map is built and 'slot' is live.
+    // Post condition: Returns '#' and the entry counted from 1, followed by '.' and the generation if it is not 0.
+
+    uint64_t id = taskId(slot);
+    string text = "#" + to_string((id & UINT32_MAX) + 1);
+    if (id >> 32 != 0) text += "." + to_string(id >> 32);
+    return text;
+}
+
+
+// Function to find the slot of the task with an ID
+size_t slotOfTaskId(uint64_t id) {
+    // Precondition: The task ID map is built.
+    // Post condition: Returns the slot of the task with the ID, or NO_TASK if no entry has it or its task was deleted.
+
+    uint64_t entry = id & UINT32_MAX;
+    if (entry >= taskIds.entries.size()) return NO_TASK;
+    const TaskIdEntry& found = taskIds.entries[entry];
+    if (found.generation != id >> 32 || found.slot == NO_ID) return NO_TASK;  // A stale ID from an earlier generation
+    return found.slot;
+}
+
+
+// Function to read the task a command is for
+size_t readTaskSlot(CowVector<Task>& tasks) {
+    // Precondition: The user has been asked for a task number or ID.
+    // Post condition: Returns the slot of the task typed in, as a number or as an ID starting with '#', or NO_TASK
+    //                 after telling the user why there is none.
+
+    string answer;
+    readLine(answer);
+    ensureTasksLoaded(tasks);  // The shards are read the first time a task is touched
+
+    const char* text = answer.data();
+    const char* end = text + answer.size();
+    bool byId = text != end && *text == '#';
+    uint64_t number = 0;
+    uint64_t generation = 0;
+    auto [next, error] = from_chars(text + byId, end, number);
+    if (byId && error == errc() && next != end && *next == '.') {
+        from_chars_result part = from_chars(next + 1, end, generation);
+        next = part.ptr;
+        error = part.ec;
+    }
+    bool valid = error == errc() && next == end && number > 0 && number <= UINT32_MAX && generation <= UINT32_MAX;
+
+    if (!byId) {
+        if (valid && number <= countTasks(tasks)) return slotOfTask(number - 1);
+        cout << "Invalid task number." << endl;
+        return NO_TASK;
+    }
+    ensureTaskIds(tasks);
+    size_t slot = valid ? slotOfTaskId(generation << 32 | (number - 1)) : NO_TASK;
+    if (slot == NO_TASK) cout << "No task has the ID " << answer << "; it may have been deleted." << endl;
+    return slot;
+}
+
+
+// Function to build the trigram index
+void ensureTrigramIndex(const CowVector<Task>& tasks) {
+    // Precondition: The shards are loaded.
+    // Post condition: The trigram index holds the title of every live task.
+
+    if (trigramIndex.built) return;
+    trigramIndex.postings.assign(TRIGRAM_BUCKETS, vector<uint32_t>());
+    trigramIndex.retitled.clear();
+    trigramIndex.staleEntries = 0;
+    trigramIndex.built = true;
+
+    // Every thread reads all the titles but fills only its own range of lists, so each list still grows in slot
+    // order and nothing needs merging afterwards. A first pass counts the entries of each list, so the lists are
+    // filled without ever growing and carry no spare room
+    vector<uint32_t> counts(TRIGRAM_BUCKETS, 0);
+    vector<uint32_t> lastSlot(TRIGRAM_BUCKETS, NO_ID);  // Slot last counted in each list, to count a repeated trigram once
+    size_t threadCount = min<size_t>(max(1u, thread::hardware_concurrency()), tasks.size() / MIN_THREAD_TASKS + 1);
+    runInParallel(threadCount, [&](size_t t) {
+        size_t first = TRIGRAM_BUCKETS * t / threadCount;
+        size_t last = TRIGRAM_BUCKETS * (t + 1) / threadCount;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            if (isDeadSlot(i)) continue;
+            string_view title = tasks[i].title;
+            for (size_t j = 0; j + TRIGRAM_LENGTH <= title.size(); ++j) {
+                uint32_t bucket = trigramBucket(title.data() + j);
+                if (bucket < first || bucket >= last || lastSlot[bucket] == i) continue;
+                lastSlot[bucket] = static_cast<uint32_t>(i);
+                ++counts[bucket];
+            }
+        }
+        for (size_t bucket = first; bucket < last; ++bucket) trigramIndex.postings[bucket].reserve(counts[bucket]);
+
+        // Writing each entry straight into its list would touch another page for nearly every trigram, so the
+        // entries of a batch of titles are first grouped by the top bits of their list, a stable counting sort,
+        // and then written out a group at a time while the ends of the group's lists stay in the cache and the TLB
+        vector<uint64_t> entries;  // List above slot, in title order
+        vector<uint64_t> grouped;  // The same entries grouped by list
+        for (size_t begin = 0; begin < tasks.size(); begin += TRIGRAM_BUILD_BATCH) {
+            size_t end = min(tasks.size(), begin + TRIGRAM_BUILD_BATCH);
+            size_t groupStarts[(size_t(1) << TRIGRAM_GROUP_BITS) + 1] = {};
+            entries.clear();
+            for (size_t i = begin; i < end; ++i) {
+                if (isDeadSlot(i)) continue;
+                string_view title = tasks[i].title;
+                for (size_t j = 0; j + TRIGRAM_LENGTH <= title.size(); ++j) {
+                    uint32_t bucket = trigramBucket(title.data() + j);
+                    if (bucket < first || bucket >= last) continue;
+                    entries.push_back(uint64_t(bucket) << 32 | i);
+                    ++groupStarts[(bucket >> (TRIGRAM_BUCKET_BITS - TRIGRAM_GROUP_BITS)) + 1];
+                }
+            }
+            for (size_t group = 1; group <= size_t(1) << TRIGRAM_GROUP_BITS; ++group) groupStarts[group] += groupStarts[group - 1];
+            grouped.resize(entries.size());
+            for (uint64_t entry : entries) grouped[groupStarts[entry >> (32 + TRIGRAM_BUCKET_BITS - TRIGRAM_GROUP_BITS)]++] = entry;
+            for (uint64_t entry : grouped) {
+                vector<uint32_t>& list = trigramIndex.postings[entry >> 32];
+                uint32_t slot = static_cast<uint32_t>(entry);
+                if (list.empty() || list.back() != slot) list.push_back(slot);  // A trigram repeated in the title
+            }
+        }
+    });
+    trigramIndex.entries = 0;
+    for (uint32_t count : counts) trigramIndex.entries += count;
+}
+
+
+// Function to add a task's title to the trigram index
+void indexTrigrams(const CowVector<Task>& tasks, size_t position) {
+    // Precondition: 'position' is a live slot of 'tasks', new or with a new title.
+    // Post condition: The list of every trigram of the task's title holds 'position', or the task is on the retitled
+    //                 list. Nothing happens while the index is not built.
+
+    if (!trigramIndex.built) return;
+    uint32_t entry = static_cast<uint32_t>(position);
+    if (position + 1 != tasks.size()) {
+        // Only the last task can go at the end of the lists
+        vector<uint32_t>& retitled = trigramIndex.retitled;
+        auto place = lower_bound(retitled.begin(), retitled.end(), entry);
+        if (place == retitled.end() || *place != entry) retitled.insert(place, entry);
+        if (retitled.size() > TRIGRAM_RETITLED_LIMIT) trigramIndex.built = false;
+        return;
+    }
+    string_view title = tasks[position].title;
+    for (size_t j = 0; j + TRIGRAM_LENGTH <= title.size(); ++j) {
+        vector<uint32_t>& list = trigramIndex.postings[trigramBucket(title.data() + j)];
+        if (!list.empty() && list.back() == entry) continue;  // A repeated trigram, or an entry of the old title
+        list.push_back(entry);
+        ++trigramIndex.entries;
+    }
+}
+
+
+// Function to count the trigram entries of a task's old title as stale
+void retireTrigrams(const CowVector<Task>& tasks, size_t position) {
+    // Precondition: The task at 'position' still has the title it was indexed under, and is being deleted or retitled.
+    // Post condition: The entries stay in the lists and are counted as stale; once they reach half of all entries,
+    //                 the next search builds the index afresh. Nothing happens while the index is not built.
+
+    if (!trigramIndex.built) return;
+    string_view title = tasks[position].title;
+    trigramIndex.staleEntries += title.size() >= TRIGRAM_LENGTH ? title.size() - TRIGRAM_LENGTH + 1 : 0;
+    if (trigramIndex.staleEntries * 2 > trigramIndex.entries) trigramIndex.built = false;
+}
+
+
+// Function to find the posting list of a trigram
+uint32_t trigramBucket(const char* bytes) {
+    // Precondition: 'bytes' points at TRIGRAM_LENGTH readable bytes.
+    // Post condition: Returns a list number below TRIGRAM_BUCKETS, the same for trigrams that differ only in the
+    //                 case of ASCII letters.
+
+    uint32_t code = 0;
+    for (size_t i = 0; i < TRIGRAM_LENGTH; ++i) {
+        unsigned char byte = static_cast<unsigned char>(bytes[i]);
+        if (byte >= 'A' && byte <= 'Z') byte += 'a' - 'A';
+        code = code << 8 | byte;
+    }
+    return (code * 0x9E3779B1u) >> (32 - TRIGRAM_BUCKET_BITS);
+}
+
+
+// Function to list the tasks whose titles contain a text
+void searchTitles(const CowVector<Task>& tasks, string_view text, vector<size_t>& out) {
+    // Precondition: The trigram index is built, unless 'text' is shorter than TRIGRAM_LENGTH.
+    // Post condition: 'out' holds the positions of the live tasks whose titles contain 'text', ignoring the case of
+    //                 ASCII letters, in list order.
+
+    out.clear();
+    if (text.size() < TRIGRAM_LENGTH) {
+        // Too short to hold a trigram, so every title is checked
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            if (!isDeadSlot(i) && titleContains(tasks[i].title, text)) out.push_back(i);
+        }
+        return;
+    }
+
+    // Intersect the lists of the text's trigrams, shortest first, so the candidates only ever shrink and each is
+    // looked for in the longer lists by binary search
+    vector<const vector<uint32_t>*> lists;
+    for (size_t j = 0; j + TRIGRAM_LENGTH <= text.size(); ++j) lists.push_back(&trigramIndex.postings[trigramBucket(text.data() + j)]);
+    sort(lists.begin(), lists.end(), [](const vector<uint32_t>* a, const vector<uint32_t>* b) {
+        return a->size() != b->size() ? a->size() < b->size() : a < b;
+    });
+    lists.erase(unique(lists.begin(), lists.end()), lists.end());
+    vector<uint32_t> candidates(*lists[0]);
+    for (size_t l = 1; l < lists.size() && !candidates.empty(); ++l) {
+        const vector<uint32_t>& list = *lists[l];
+        auto from = list.begin();
+        size_t kept = 0;
+        for (uint32_t slot : candidates) {
+            from = lower_bound(from, list.end(), slot);
+            if (from == list.end()) break;
+            if (*from == slot) candidates[kept++] = slot;
+        }
+        candidates.resize(kept);
+    }
+
+    // Sharing a list, holding every trigram in another order or being left behind by a deleted task or an old
+    // title does not make a match, so the titles decide. Retitled tasks are checked whether or not the lists name
+    // them, in list order with the rest
+    auto check = [&](uint32_t slot) {
+        if (!isDeadSlot(slot) && titleContains(tasks[slot].title, text)) out.push_back(slot);
+    };
+    const vector<uint32_t>& retitled = trigramIndex.retitled;
+    auto next = retitled.begin();
+    for (uint32_t slot : candidates) {
+        while (next != retitled.end() && *next < slot) check(*next++);
+        if (next != retitled.end() && *next == slot) ++next;
+        check(slot);
+    }
+    while (next != retitled.end()) check(*next++);
+}
+
+
+// Function to check whether a title contains a text
+bool titleContains(string_view title, string_view text) {
+    // Precondition: None
+    // Post condition: Returns true if 'text' occurs in 'title' when ASCII letters are compared without case.
+
+    auto folded = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c; };
+    return search(title.begin(), title.end(), text.begin(), text.end(), [&](char a, char b) { return folded(a) == folded(b); }) != title.end();
+}
+
+// Function to build the title trie
+void ensureTitleTrie(const CowVector<Task>& tasks) {
+    // Precondition: The shards are loaded.
+    // Post condition: The trie holds the title of every live task. Of several tasks with the same title, the first
+    //                 is held.
+
+    if (titleTrie.built) return;
+    titleTrie.nodes.assign(1, TrieNode());
+    titleTrie.freeNodes.clear();
+    titleTrie.built = true;
+
+    // With the titles in byte order the trie only ever grows along its right edge, so the nodes on that edge are
+    // kept on a stack and no child list is ever searched. The radix sort orders the titles by their first eight
+    // bytes without reading a title twice; only titles sharing those are compared in full
+    vector<uint64_t> keys;
+    vector<uint32_t> order;
+    keys.reserve(tasks.size() - tombstones.deadCount);
+    order.reserve(tasks.size() - tombstones.deadCount);
     for (size_t i = 0; i < tasks.size(); ++i) {
-        // Write each task's details to the file
-        outFile << tasks[i].title << endl
-                << tasks[i].dueDate << endl
-                << tasks[i].priority << endl
-                << tasks[i].completed << endl;
+        if (isDeadSlot(i)) continue;
+        string_view title = tasks[i].title;
+        uint64_t key = 0;
+        for (size_t k = 0; k < sizeof(key); ++k) key = key << 8 | (k < title.size() ? static_cast<unsigned char>(title[k]) : 0);
+        keys.push_back(key);
+        order.push_back(static_cast<uint32_t>(i));
+    }
+    radixSortOrder(keys, order);
+    for (size_t begin = 0, end; begin < keys.size(); begin = end) {
+        for (end = begin + 1; end < keys.size() && keys[end] == keys[begin]; ++end) {}
+        if (end - begin < 2) continue;
+        sort(order.begin() + begin, order.begin() + end, [&](uint32_t a, uint32_t b) {
+            int difference = string_view(tasks[a].title).compare(tasks[b].title);
+            return difference != 0 ? difference < 0 : a < b;
+        });
     }
 
-    cout << "Tasks saved successfully." << endl;  // Inform the user that tasks have been saved
+    struct Open {
+        uint32_t node;       // Node on the right edge
+        uint32_t lastChild;  // Its last child so far, or NO_ID
+        size_t end;          // Length of the node's path
+    };
+    vector<Open> edge = {{0, NO_ID, 0}};
+    string_view previous;
+    for (uint32_t slot : order) {
+        string_view title = tasks[slot].title;
+        size_t common = mismatch(title.begin(), title.begin() + min(title.size(), previous.size()), previous.begin()).first - title.begin();
+        previous = title;
+        uint32_t cut = NO_ID;
+        while (edge.back().end > common) {
+            cut = edge.back().node;
+            edge.pop_back();
+        }
+        if (edge.back().end < common) {
+            // The last node taken off the edge runs past the bytes the titles share, so it is cut where they differ
+            splitTrieNode(cut, common - edge.back().end);
+            edge.push_back({cut, titleTrie.nodes[cut].firstChild, common});
+        }
+        if (title.size() == common) {
+            if (titleTrie.nodes[edge.back().node].slot == NO_ID) titleTrie.nodes[edge.back().node].slot = slot;
+            continue;  // The same title again
+        }
+        uint32_t leaf = newTrieNode(title.substr(common), slot);
+        if (edge.back().lastChild == NO_ID) titleTrie.nodes[edge.back().node].firstChild = leaf;
+        else titleTrie.nodes[edge.back().lastChild].nextSibling = leaf;
+        edge.back().lastChild = leaf;
+        edge.push_back({leaf, NO_ID, title.size()});
+    }
+}
+
+
+// Function to add a task's title to the title trie
+void addTitleToTrie(const CowVector<Task>& tasks, size_t position) {
+    // Precondition: The task at 'position' is live and not in the trie.
+    // Post condition: The task's title leads to 'position', unless another task already holds the title. Nothing
+    //                 happens while the trie is not built.
+
+    if (!titleTrie.built) return;
+    string_view title = tasks[position].title;
+    uint32_t node = 0;
+    size_t depth = 0;
+    while (depth < title.size()) {
+        uint32_t previous;
+        uint32_t child = findTrieChild(node, title[depth], previous);
+        if (child == NO_ID) {
+            // No title goes on with this byte yet, so the rest of the title becomes a new leaf
+            uint32_t leaf = newTrieNode(title.substr(depth), position);
+            uint32_t& link = previous == NO_ID ? titleTrie.nodes[node].firstChild : titleTrie.nodes[previous].nextSibling;
+            titleTrie.nodes[leaf].nextSibling = link;
+            link = leaf;
+            return;
+        }
+        // Follow the child as far as its label agrees with the title, cutting it where they part
+        const TrieNode& next = titleTrie.nodes[child];
+        size_t length = min<size_t>(next.labelLength, title.size() - depth);
+        size_t common = mismatch(next.label, next.label + length, title.data() + depth).first - next.label;
+        if (common < next.labelLength) splitTrieNode(child, common);
+        node = child;
+        depth += common;
+    }
+    if (titleTrie.nodes[node].slot == NO_ID) titleTrie.nodes[node].slot = static_cast<uint32_t>(position);
+}
+
+
+// Function to remove a task's title from the title trie
+void removeTitleFromTrie(const CowVector<Task>& tasks, size_t position) {
+    // Precondition: The task at 'position' still has the title it was added under.
+    // Post condition: The title no longer leads to 'position', and nodes left without a purpose are unlinked or
+    //                 merged. Nothing happens while the trie is not built.
+
+    if (!titleTrie.built) return;
+    string_view title = tasks[position].title;
+    uint32_t parent = NO_ID;
+    uint32_t previous = NO_ID;  // Sibling before 'node', or NO_ID if it is the first child
+    uint32_t node = 0;
+    size_t depth = 0;
+    while (depth < title.size()) {
+        uint32_t before;
+        uint32_t child = findTrieChild(node, title[depth], before);
+        if (child == NO_ID) return;
+        const TrieNode& next = titleTrie.nodes[child];
+        if (next.labelLength > title.size() - depth || memcmp(next.label, title.data() + depth, next.labelLength) != 0) return;
+        parent = node;
+        previous = before;
+        node = child;
+        depth += next.labelLength;
+    }
+    if (titleTrie.nodes[node].slot != position) return;  // A duplicate title that was never added
+    titleTrie.nodes[node].slot = NO_ID;
+    if (node == 0) return;
+
+    if (titleTrie.nodes[node].firstChild == NO_ID) {
+        // Nothing leads on from the node, so it goes, and its parent may be left with a single child
+        uint32_t& link = previous == NO_ID ? titleTrie.nodes[parent].firstChild : titleTrie.nodes[previous].nextSibling;
+        link = titleTrie.nodes[node].nextSibling;
+        titleTrie.freeNodes.push_back(node);
+        node = parent;
+        if (node == 0 || titleTrie.nodes[node].slot != NO_ID) return;
+    }
+    mergeTrieNode(node);
+}
+
+
+// Function to take a free trie node
+uint32_t newTrieNode(string_view label, size_t slot) {
+    // Precondition: 'label' lies in a title that starts with the path of the node's parent, right after it.
+    // Post condition: Returns an unlinked node holding the label and 'slot', reusing a node freed by a delete.
+
+    TrieNode node;
+    node.label = label.data();
+    node.labelLength = static_cast<uint32_t>(label.size());
+    node.slot = static_cast<uint32_t>(slot);
+    if (titleTrie.freeNodes.empty()) {
+        titleTrie.nodes.push_back(node);
+        return static_cast<uint32_t>(titleTrie.nodes.size() - 1);
+    }
+    uint32_t index = titleTrie.freeNodes.back();
+    titleTrie.freeNodes.pop_back();
+    titleTrie.nodes[index] = node;
+    return index;
+}
+
+
+// Function to cut a trie node's label in two
+void splitTrieNode(uint32_t node, size_t length) {
+    // Precondition: 'length' is greater than 0 and less than the node's label length.
+    // Post condition: The node keeps the first 'length' bytes of its label and no title; a new only child holds
+    //                 the rest of the label, the node's children and its title. The node stays where it was in
+    //                 its parent's child list.
+
+    const TrieNode& whole = titleTrie.nodes[node];
+    uint32_t lower = newTrieNode(string_view(whole.label + length, whole.labelLength - length), whole.slot);
+    TrieNode& upper = titleTrie.nodes[node];  // Taken again, since the new node may have moved the nodes
+    titleTrie.nodes[lower].firstChild = upper.firstChild;
+    upper.labelLength = static_cast<uint32_t>(length);
+    upper.firstChild = lower;
+    upper.slot = NO_ID;
+}
+
+
+// Function to merge a trie node with its only child
+void mergeTrieNode(uint32_t node) {
+    // Precondition: 'node' is not the root and no title ends at it.
+    // Post condition: If the node has exactly one child, it takes over the child's label, children and title, its
+    //                 label now running on into the child's, and the child is freed. Otherwise nothing happens.
+
+    TrieNode& upper = titleTrie.nodes[node];
+    if (upper.firstChild == NO_ID || titleTrie.nodes[upper.firstChild].nextSibling != NO_ID) return;
+    uint32_t child = upper.firstChild;
+    const TrieNode& lower = titleTrie.nodes[child];
+    // The child's label lies in a title that starts with the child's whole path, so the node's label is right before it
+    upper.label = lower.label - upper.labelLength;
+    upper.labelLength += lower.labelLength;
+    upper.firstChild = lower.firstChild;
+    upper.slot = lower.slot;
+    titleTrie.freeNodes.push_back(child);
+}
+
+
+// Function to find the child of a trie node that starts with a byte
+uint32_t findTrieChild(uint32_t node, char byte, uint32_t& previous) {
+    // Precondition: 'node' is linked into the trie.
+    // Post condition: Returns the child whose label starts with 'byte', or NO_ID. 'previous' is the last child
+    //                 that sorts before 'byte', or NO_ID, which is where a new child for 'byte' would be linked.
+
+    previous = NO_ID;
+    unsigned char wanted = static_cast<unsigned char>(byte);
+    for (uint32_t child = titleTrie.nodes[node].firstChild; child != NO_ID; child = titleTrie.nodes[child].nextSibling) {
+        unsigned char first = static_cast<unsigned char>(titleTrie.nodes[child].label[0]);
+        if (first == wanted) return child;
+        if (first > wanted) break;
+        previous = child;
+    }
+    return NO_ID;
+}
+
+
+// Function to list the tasks whose titles start with a prefix
+void completeTitle(string_view prefix, size_t limit, vector<size_t>& out) {
+    // Precondition: The title trie is built.
+    // Post condition: 'out' holds the positions of up to 'limit' tasks whose titles start with 'prefix', in byte
+    //                 order of their titles.
+
+    out.clear();
+    uint32_t node = 0;
+    size_t depth = 0;
+    while (depth < prefix.size()) {
+        uint32_t previous;
+        uint32_t child = findTrieChild(node, prefix[depth], previous);
+        if (child == NO_ID) return;
+        const TrieNode& next = titleTrie.nodes[child];
+        size_t length = min<size_t>(next.labelLength, prefix.size() - depth);
+        if (memcmp(next.label, prefix.data() + depth, length) != 0) return;
+        node = child;
+        depth += length;
+    }
+
+    // Every title below the node starts with the prefix; walk them in order, a child before its next sibling
+    vector<uint32_t> pending = {node};
+    while (!pending.empty() && out.size() < limit) {
+        uint32_t visit = pending.back();
+        pending.pop_back();
+        const TrieNode& current = titleTrie.nodes[visit];
+        if (current.slot != NO_ID) out.push_back(current.slot);
+        if (visit != node && current.nextSibling != NO_ID) pending.push_back(current.nextSibling);
+        if (current.firstChild != NO_ID) pending.push_back(current.firstChild);
+    }
+}
+
+
+// Function to list the tasks whose titles are close to a text
+void suggestTitles(string_view text, size_t maxDistance, size_t except, size_t limit, vector<size_t>& out) {
+    // Precondition: The title trie is built.
+    // Post condition: 'out' holds the positions of up to 'limit' tasks other than 'except' whose titles are at most
+    //                 'maxDistance' single-byte insertions, deletions or substitutions away from 'text', closest
+    //                 first and in byte order of their titles among equals.
+
+    // Walk the trie keeping one row of the edit distance table per byte of the path, so titles sharing a prefix
+    // share its rows. A branch is left as soon as every entry of its last row exceeds 'maxDistance'
+    const size_t width = text.size() + 1;
+    vector<uint32_t> rows((text.size() + maxDistance + 2) * width);
+    for (size_t j = 0; j < width; ++j) rows[j] = static_cast<uint32_t>(j);
+    vector<pair<uint32_t, uint32_t>> found;  // Distance and slot of every title close enough
+    function<void(uint32_t, size_t)> visit = [&](uint32_t node, size_t depth) {
+        const TrieNode& current = titleTrie.nodes[node];
+        for (size_t k = 0; k < current.labelLength; ++k, ++depth) {
+            const uint32_t* above = &rows[depth * width];
+            uint32_t* row = &rows[(depth + 1) * width];
+            row[0] = static_cast<uint32_t>(depth + 1);
+            uint32_t lowest = row[0];
+            for (size_t j = 1; j < width; ++j) {
+                uint32_t substitution = above[j - 1] + (text[j - 1] != current.label[k]);
+                row[j] = min({above[j] + 1, row[j - 1] + 1, substitution});
+                lowest = min(lowest, row[j]);
+            }
+            if (lowest > maxDistance) return;
+        }
+        if (current.slot != NO_ID && current.slot != except && rows[depth * width + text.size()] <= maxDistance) {
+            found.emplace_back(rows[depth * width + text.size()], current.slot);
+        }
+        for (uint32_t child = current.firstChild; child != NO_ID; child = titleTrie.nodes[child].nextSibling) visit(child, depth);
+    };
+    visit(0, 0);
+
+    // The walk met the titles in byte order, so a stable sort by distance keeps that order among equals
+    stable_sort(found.begin(), found.end(), [](const pair<uint32_t, uint32_t>& a, const pair<uint32_t, uint32_t>& b) { return a.first < b.first; });
+    out.clear();
+    for (size_t i = 0; i < found.size() && i < limit; ++i) out.push_back(found[i].second);
+}
+
+
+// Function to read a title, listing the titles that start with what has been typed on request
+string readTitle(CowVector<Task>& tasks, const char* prompt) {
+    // Precondition: None
+    // Post condition: Returns the first line typed that does not end with COMPLETION_KEY. For a line that does,
+    //                 up to COMPLETION_LIMIT titles starting with the rest of the line are listed and the prompt is
+    //                 shown again.
+
+    string title;
+    cout << prompt << endl;
+    while (readLine(title) && !title.empty() && title.back() == COMPLETION_KEY) {
+        while (!title.empty() && title.back() == COMPLETION_KEY) title.pop_back();
+        ensureTasksLoaded(tasks);  // Asking for completions reads the shards, as a listing does
+        ensureTitleTrie(tasks);
+        vector<size_t> found;
+        completeTitle(title, COMPLETION_LIMIT + 1, found);
+        if (found.empty()) cout << "No task title starts with \"" << title << "\"." << endl;
+        for (size_t i = 0; i < found.size() && i < COMPLETION_LIMIT; ++i) cout << "  " << tasks[found[i]].title << endl;
+        if (found.size() > COMPLETION_LIMIT) cout << "  ..." << endl;
+        cout << prompt << endl;
+    }
+    return title;
+}
+
+
+// Function to tell the user about existing titles close to a new one
+void showSimilarTitles(CowVector<Task>& tasks, string_view title, size_t except) {
+    // Precondition: No task other than the one in slot 'except', if any, has 'title'.
+    // Post condition: Up to SUGGESTION_LIMIT tasks with titles a few edits from 'title' are listed. Nothing is
+    //                 listed while the shards are unloaded, since a hint is not worth reading them all.
+
+    // Short titles get fewer edits, or every two-letter title would be close to every other
+    size_t maxDistance = min(MAX_SUGGESTION_DISTANCE, title.size() / 4);
+    if (!shardStore.loaded || maxDistance == 0) return;
+    ensureTitleTrie(tasks);
+    vector<size_t> similar;
+    suggestTitles(title, maxDistance, except, SUGGESTION_LIMIT, similar);
+    for (size_t slot : similar) cout << "Did you mean task " << taskIndex(slot) + 1 << ". " << tasks[slot].title << "?" << endl;
+}
+
+// Function to choose the order viewTasks shows the list in
+void selectSortedView(const uint8_t* fields) {
+    // Precondition: 'fields' holds MAX_SORT_FIELDS sort fields.
+    // Post condition: 'activeView' is the view ordered by 'fields', reused if it is kept already and otherwise
+    //                 added unbuilt, dropping the view chosen longest ago once MAX_SORTED_VIEWS are kept.
+
+    for (size_t v = 0; v < sortedViews.size(); ++v) {
+        if (equal(fields, fields + MAX_SORT_FIELDS, sortedViews[v].fields)) {
+            rotate(sortedViews.begin() + v, sortedViews.begin() + v + 1, sortedViews.end());  // Now the latest choice
+            activeView = sortedViews.size() - 1;
+            return;
+        }
+    }
+    if (sortedViews.size() == MAX_SORTED_VIEWS) sortedViews.erase(sortedViews.begin());
+    sortedViews.emplace_back();
+    copy(fields, fields + MAX_SORT_FIELDS, sortedViews.back().fields);
+    activeView = sortedViews.size() - 1;
+}
+
+
+// Function to build a sorted view
+void ensureSortedView(const CowVector<Task>& tasks, SortedView& view) {
+    // Precondition: The shards are loaded.
+    // Post condition: The view holds one entry for every live task, all of them in the sorted array.
+
+    if (view.built) return;
+    vector<uint64_t> keys;
+    vector<uint32_t> order;
+    keys.reserve(tasks.size() - tombstones.deadCount);
+    order.reserve(tasks.size() - tombstones.deadCount);
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (isDeadSlot(i)) continue;
+        keys.push_back(packSortKey(tasks[i], view.fields));
+        order.push_back(static_cast<uint32_t>(i));
+    }
+    radixSortOrder(keys, order);  // Stable, so equal keys stay in list order
+    view.sorted.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) view.sorted[i] = keys[i] << 32 | order[i];
+    view.recent.clear();
+    view.built = true;
+}
+
+
+// Function to enter a task's current fields in the sorted views
+void addToSortedViews(const CowVector<Task>& tasks, size_t position) {
+    // Precondition: The task at 'position' is live and has just been added or changed.
+    // Post condition: Every built view has the task's current entry. A view holding more than one entry in
+    //                 TOMBSTONE_COMPACTION_RATIO that no longer counts is dropped, to be built afresh when next shown.
+
+    for (SortedView& view : sortedViews) {
+        if (!view.built) continue;
+        uint64_t entry = packSortKey(tasks[position], view.fields) << 32 | position;
+        // The entry is there already if the fields the view orders by did not change, or changed back
+        if (binary_search(view.sorted.begin(), view.sorted.end(), entry)) continue;
+        vector<uint64_t>& recent = view.recent;
+        auto place = lower_bound(recent.begin(), recent.end(), entry);
+        if (place != recent.end() && *place == entry) continue;
+        recent.insert(place, entry);
+        if (recent.size() < VIEW_DELTA_LIMIT) continue;
+
+        // Merge the delta buffer into the sorted array
+        vector<uint64_t>& sorted = view.sorted;
+        size_t middle = sorted.size();
+        sorted.insert(sorted.end(), recent.begin(), recent.end());
+        inplace_merge(sorted.begin(), sorted.begin() + middle, sorted.end());
+        recent.clear();
+
+        // Entries of deleted tasks and entries left behind by changes are skipped when the view is shown; once
+        // they are too many, rebuilding reads the list in order, where weeding them out would jump around it
+        size_t live = tasks.size() - tombstones.deadCount;
+        if ((sorted.size() - live) * TOMBSTONE_COMPACTION_RATIO > sorted.size()) {
+            view.built = false;
+            vector<uint64_t>().swap(sorted);
+        }
+    }
+}
+
+
+// Function to check that a view entry still describes its task
+bool isCurrentViewEntry(const CowVector<Task>& tasks, const SortedView& view, uint64_t entry) {
+    // Precondition: 'entry' is an entry of 'view', which is built.
+    // Post condition: Returns true if the entry's slot holds a live task whose fields still give the entry's key.
+
+    size_t slot = entry & UINT32_MAX;
+    return !isDeadSlot(slot) && packSortKey(tasks[slot], view.fields) == entry >> 32;
+}
+
+
+// Function to list the tasks in the order of a view
+void listSortedView(const CowVector<Task>& tasks, SortedView& view, vector<size_t>& out) {
+    // Precondition: The shards are loaded.
+    // Post condition: 'out' holds the position of every live task, ordered by the view's fields and then by
+    //                 position. The view is built first if needed.
+
+    ensureSortedView(tasks, view);
+    out.clear();
+    out.reserve(tasks.size() - tombstones.deadCount);
+    auto older = view.sorted.begin();
+    auto newer = view.recent.begin();
+    while (older != view.sorted.end() || newer != view.recent.end()) {
+        // Take the smaller of the next entries of the two arrays
+        bool useOlder = newer == view.recent.end() || (older != view.sorted.end() && *older < *newer);
+        uint64_t entry = useOlder ? *older++ : *newer++;
+        if (isCurrentViewEntry(tasks, view, entry)) out.push_back(entry & UINT32_MAX);
+    }
+}
+
+
+// Function to describe sort fields in words
+string sortFieldsText(const uint8_t* fields) {
+    // Precondition: 'fields' holds MAX_SORT_FIELDS sort fields.
+    // Post condition: Returns the fields in order, such as "priority (descending), due date".
+
+    string text;
+    for (size_t f = 0; f < MAX_SORT_FIELDS && fields[f] != SORT_FIELD_NONE; ++f) {
+        if (!text.empty()) text += ", ";
+        uint8_t field = fields[f] & ~SORT_DESCENDING;
+        text += field == SORT_FIELD_PRIORITY ? "priority" : field == SORT_FIELD_DUE_DATE ? "due date" : "status";
+        if (fields[f] & SORT_DESCENDING) text += " (descending)";
+    }
+    return text;
+}
+
+// Function to build the task counters
+void ensureTaskStats(const CowVector<Task>& tasks) {
+    // Precondition: The shards are loaded.
+    // Post condition: The counters cover every live task, with 'overdue' counted up to today.
+
+    if (taskStats.built) return;
+    taskStats = TaskStats();
+    taskStats.today = today();
+    taskStats.built = true;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (!isDeadSlot(i)) addToStats(tasks[i]);
+    }
+}
+
+
+// Function to count a task in the task counters
+void addToStats(const Task& task) {
+    // Precondition: The task is live and not counted yet.
+    // Post condition: The counters include the task. Nothing happens while they are not built.
+
+    if (!taskStats.built) return;
+    ++taskStats.byPriority[task.completed][task.priority];
+    if (task.completed) {
+        ++taskStats.completed;
+        return;
+    }
+    if (task.dueDay == NO_DUE_DAY) return;  // A malformed date is never overdue, as in the overdue listing
+    ++taskStats.pendingByDay[task.dueDay];
+    if (task.dueDay < taskStats.today) ++taskStats.overdue;
+}
+
+
+// Function to take a task out of the task counters
+void removeFromStats(const Task& task) {
+    // Precondition: The task is counted with the fields it has now.
+    // Post condition: The counters no longer include the task. Nothing happens while they are not built.
+
+    if (!taskStats.built) return;
+    --taskStats.byPriority[task.completed][task.priority];
+    if (task.completed) {
+        --taskStats.completed;
+        return;
+    }
+    if (task.dueDay == NO_DUE_DAY) return;
+    auto found = taskStats.pendingByDay.find(task.dueDay);
+    if (--found->second == 0) taskStats.pendingByDay.erase(found);
+    if (task.dueDay < taskStats.today) --taskStats.overdue;
+}
+
+
+// Function to move the overdue count up to today
+void advanceStatsDay() {
+    // Precondition: The task counters are built.
+    // Post condition: 'overdue' counts the pending tasks due before today, even if the date has changed since it
+    //                 was last counted, or the clock has been set back.
+
+    uint32_t now = today();
+    if (now == taskStats.today) return;
+
+    // Add or take off the tasks due on the days in between, reading whichever is fewer: those days, or the days
+    // that have pending tasks at all
+    uint32_t first = min(now, taskStats.today);
+    uint32_t last = max(now, taskStats.today);
+    uint64_t between = 0;
+    if (last - first <= taskStats.pendingByDay.size()) {
+        for (uint32_t day = first; day < last; ++day) {
+            auto found = taskStats.pendingByDay.find(day);
+            if (found != taskStats.pendingByDay.end()) between += found->second;
+        }
+    } else {
+        for (const auto& [day, count] : taskStats.pendingByDay) {
+            if (day >= first && day < last) between += count;
+        }
+    }
+    taskStats.overdue = now > taskStats.today ? taskStats.overdue + between : taskStats.overdue - between;
+    taskStats.today = now;
+}
+
+
+// Function to report the task counters
+void showTaskStats(CowVector<Task>& tasks) {
+    // Precondition: None
+    // Post condition: The status, overdue and priority counts of the list are displayed. Only the counters are
+    //                 read, so the report takes the same time for any list size.
+
+    ensureTasksLoaded(tasks);
+    ensureTaskStats(tasks);
+    advanceStatsDay();
+    auto pendingOn = [](uint32_t day) {
+        auto found = taskStats.pendingByDay.find(day);
+        return found == taskStats.pendingByDay.end() ? uint64_t(0) : found->second;
+    };
+
+    size_t total = countTasks(tasks);
+    uint64_t completed = taskStats.completed;
+    cout << endl << "--- Task Statistics ---" << endl;
+    cout << "Tasks: " << total << ", " << total - completed << " pending, " << completed << " completed";
+    if (total > 0) cout << " (" << completed * 100 / total << "% done)";
+    cout << endl;
+
+    // The overdue tasks of the last few days one day at a time, and the older ones together
+    cout << "Due today: " << pendingOn(taskStats.today) << " pending" << endl;
+    cout << "Overdue: " << taskStats.overdue << " pending" << endl;
+    uint64_t listed = 0;
+    for (uint32_t back = 1; back <= OVERDUE_REPORT_DAYS && back < taskStats.today; ++back) {
+        uint64_t count = pendingOn(taskStats.today - back);
+        listed += count;
+        if (count > 0) cout << "  Due " << dayText(taskStats.today - back) << ": " << count << endl;
+    }
+    if (taskStats.overdue > listed) cout << "  Due earlier: " << taskStats.overdue - listed << endl;
+
+    cout << "By priority (pending / completed):" << endl;
+    for (int priority = MAX_PRIORITY; priority >= MIN_PRIORITY; --priority) {
+        uint64_t pending = taskStats.byPriority[0][priority];
+        uint64_t done = taskStats.byPriority[1][priority];
+        if (pending + done > 0) cout << "  Priority " << priority << ": " << pending << " / " << done << endl;
+    }
+}
+
+// Function to serialize a journal record, framed with its size and checksum
+void encodeJournalRecord(const JournalRecord& record, vector<char>& out) {
+    // Precondition: None
+    // Post condition: The framed record is appended to 'out'.
+
+    vector<char> payload;
+    auto put = [&payload](const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        payload.insert(payload.end(), bytes, bytes + size);
+    };
+
+    put(&record.op, sizeof(record.op));
+    put(&record.seq, sizeof(record.seq));
+    put(&record.index, sizeof(record.index));
+    if (record.op == JOURNAL_ADD || record.op == JOURNAL_EDIT) {
+        int32_t priority = record.task.priority;
+        uint8_t completed = record.task.completed ? 1 : 0;
+        uint32_t titleLength = static_cast<uint32_t>(record.task.title.size());
+        char dueDate[DUE_DATE_LENGTH];
+        formatDay(record.task.dueDay, dueDate);
+        put(&priority, sizeof(priority));
+        put(&completed, sizeof(completed));
+        put(dueDate, DUE_DATE_LENGTH);
+        put(&titleLength, sizeof(titleLength));
+        put(record.task.title.data(), titleLength);
+    } else if (record.op == JOURNAL_SORT) {
+        put(&record.sortKey, sizeof(record.sortKey));
+        if (record.sortKey == SORT_BY_FIELDS) put(record.sortFields, sizeof(record.sortFields));
+    }
+
+    uint32_t payloadSize = static_cast<uint32_t>(payload.size());
+    uint32_t checksum = 2166136261u;  // FNV-1a hash of the payload, used to spot records torn by a crash
+    for (char byte : payload) checksum = (checksum ^ static_cast<uint8_t>(byte)) * 16777619u;
+
+    const char* size = reinterpret_cast<const char*>(&payloadSize);
+    const char* sum = reinterpret_cast<const char*>(&checksum);
+    out.insert(out.end(), size, size + sizeof(payloadSize));
+    out.insert(out.end(), sum, sum + sizeof(checksum));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+
+// Function to parse one framed journal record
+size_t decodeJournalRecord(const char* data, size_t size, JournalRecord& record) {
+    // Precondition: 'data' points at the start of a record inside a buffer of 'size' bytes.
+    // Post condition: Returns the number of bytes the record takes, or 0 if it is incomplete or damaged.
+
+    uint32_t payloadSize, checksum;
+    if (size < sizeof(payloadSize) + sizeof(checksum)) return 0;
+    memcpy(&payloadSize, data, sizeof(payloadSize));
+    memcpy(&checksum, data + sizeof(payloadSize), sizeof(checksum));
+    size_t frameSize = sizeof(payloadSize) + sizeof(checksum);
+    if (size - frameSize < payloadSize) return 0;
+
+    const char* payload = data + frameSize;
+    uint32_t actual = 2166136261u;
+    for (uint32_t i = 0; i < payloadSize; ++i) actual = (actual ^ static_cast<uint8_t>(payload[i])) * 16777619u;
+    if (actual != checksum) return 0;
+
+    size_t offset = 0;
+    auto get = [&](void* out, size_t length) {
+        if (payloadSize - offset < length) return false;
+        memcpy(out, payload + offset, length);
+        offset += length;
+        return true;
+    };
+
+    if (!get(&record.op, sizeof(record.op)) || !get(&record.seq, sizeof(record.seq)) ||
+        !get(&record.index, sizeof(record.index))) return 0;
+    if (record.op == JOURNAL_ADD || record.op == JOURNAL_EDIT) {
+        int32_t priority;
+        uint8_t completed;
+        uint32_t titleLength;
+        char dueDate[DUE_DATE_LENGTH];
+        if (!get(&priority, sizeof(priority)) || !get(&completed, sizeof(completed)) ||
+            !get(dueDate, DUE_DATE_LENGTH) || !get(&titleLength, sizeof(titleLength)) ||
+            payloadSize - offset < titleLength) return 0;
+        record.task.priority = clampPriority(priority);
+        record.task.completed = completed != 0;
+        record.task.dueDay = dayNumber(string_view(dueDate, DUE_DATE_LENGTH));
+        record.task.title = storeTitle(string_view(payload + offset, titleLength));  // The journal is truncated later, so copy
+    } else if (record.op == JOURNAL_SORT) {
+        if (!get(&record.sortKey, sizeof(record.sortKey)) || record.sortKey < SORT_BY_PRIORITY_EXCHANGE ||
+            record.sortKey > SORT_BY_FIELDS) return 0;
+        if (record.sortKey == SORT_BY_FIELDS) {
+            if (!get(record.sortFields, sizeof(record.sortFields))) return 0;
+            for (uint8_t field : record.sortFields) {
+                if ((field & ~SORT_DESCENDING) > SORT_FIELD_STATUS) return 0;
+            }
+        }
+    } else if (record.op != JOURNAL_DELETE && record.op != JOURNAL_COMPLETE) {
+        return 0;
+    }
+    return frameSize + payloadSize;
+}
+
+
+// Function to re-apply the changes logged since the shards were written
+void replayJournal(CowVector<Task>& tasks) {
+    // Precondition: 'tasks' (or, while the shards are not loaded, the shard index) holds the list the journals were
+    //               written against and 'lastJournalSeq' is its sequence number.
+    // Post condition: Every intact record newer than that is applied, or kept in 'shardStore.pendingRecords' until
+    //                 the shards are loaded; a torn or damaged tail is cut off each file.
+
+    // A save that did not finish leaves the journal it moved aside; its records come before the others. The two
+    // names take turns as the current journal, so the one whose records start earlier is replayed first
+    uint64_t count = countTasks(tasks);
+    size_t replayed = 0;
+    replayJournalFile(tasks, JOURNAL_OLD_FILE, count, replayed);
+    uint64_t firstSeq = firstJournalSeq(JOURNAL_FILE);
+    uint64_t nextFirstSeq = firstJournalSeq(JOURNAL_NEXT_FILE);
+    string older = nextFirstSeq < firstSeq ? JOURNAL_NEXT_FILE : JOURNAL_FILE;
+    string newer = older == JOURNAL_FILE ? JOURNAL_NEXT_FILE : JOURNAL_FILE;
+    replayJournalFile(tasks, older, count, replayed);
+    replayJournalFile(tasks, newer, count, replayed);
+
+    // Carry on with whichever journal has the latest records. The other one becomes the old journal, which the next
+    // save deletes, unless a failed save already left one
+    error_code error;
+    if (max(firstSeq, nextFirstSeq) != UINT64_MAX) journalName = newer;
+    else if (min(firstSeq, nextFirstSeq) != UINT64_MAX) journalName = older;
+    else journalName = JOURNAL_FILE;
+    string other = journalName == JOURNAL_FILE ? JOURNAL_NEXT_FILE : JOURNAL_FILE;
+    if (firstJournalSeq(other) == UINT64_MAX) filesystem::remove(other, error);
+    else if (!filesystem::exists(JOURNAL_OLD_FILE, error)) filesystem::rename(other, JOURNAL_OLD_FILE, error);
+    oldJournalKept = filesystem::exists(JOURNAL_OLD_FILE, error);
+
+    shardStore.taskCount = count;
+    if (shardStore.loaded) unsavedChanges = replayed;
+    if (replayed > 0) cout << "Recovered " << replayed << " unsaved change" << (replayed == 1 ? "" : "s") << " from the journal." << endl;
+}
+
+
+// Function to re-apply the records of one journal file
+void replayJournalFile(CowVector<Task>& tasks, const string& fileName, uint64_t& count, size_t& replayed) {
+    // Precondition: 'count' is the number of tasks in the list, including records replayed so far.
+    // Post condition: The file's intact records newer than 'lastJournalSeq' are applied or kept pending, 'count' and
+    //                 'replayed' are updated, and a torn or damaged tail is cut off the file.
+
+    MappedFile file;
+    if (!mapFile(fileName, file)) return;  // No such journal
+
+    size_t validSize = 0;
+    if (file.size >= JOURNAL_HEADER_SIZE && memcmp(file.data, JOURNAL_FILE_MAGIC, sizeof(JOURNAL_FILE_MAGIC)) == 0) {
+        uint32_t version;
+        memcpy(&version, file.data + sizeof(JOURNAL_FILE_MAGIC), sizeof(version));
+        if (version == JOURNAL_FILE_VERSION) validSize = JOURNAL_HEADER_SIZE;
+    }
+
+    while (validSize > 0 && validSize < file.size) {
+        JournalRecord record;
+        size_t recordSize = decodeJournalRecord(file.data + validSize, file.size - validSize, record);
+        if (recordSize == 0) break;  // Incomplete record left by a crash; everything after it is discarded
+
+        if (record.seq > lastJournalSeq) {
+            // Records must continue exactly where the snapshot left off and refer to existing tasks
+            bool needsTask = record.op == JOURNAL_EDIT || record.op == JOURNAL_DELETE || record.op == JOURNAL_COMPLETE;
+            if (record.seq != lastJournalSeq + 1 || (needsTask && record.index >= count)) break;
+            if (record.op == JOURNAL_ADD) ++count;
+            if (record.op == JOURNAL_DELETE) --count;
+            if (shardStore.loaded) {
+                applyJournalRecord(tasks, record);
+            } else {
+                shardStore.pendingRecords.push_back(record);
+                lastJournalSeq = record.seq;
+            }
+            ++replayed;
+        }
+        validSize += recordSize;
+    }
+
+    size_t fileSize = file.size;
+    unmapFile(file);
+    if (validSize < fileSize) {
+        // Drop the unusable tail (or the whole file if its header is wrong) so new records follow intact ones
+        error_code error;
+        if (validSize == 0) filesystem::remove(fileName, error);
+        else filesystem::resize_file(fileName, validSize, error);
+        cout << "Discarded a damaged part of " << fileName << "." << endl;
+    }
+}
+
+
+// Function to open the journal for appending
+void openJournal() {
+    // Precondition: Any existing journal has been replayed.
+    // Post condition: 'journalFile' is open at the end of the journal, which starts with a valid header, and
+    //                 'spareJournal' is open under the other name unless a file there still holds records.
+
+    journalFile.close();
+    journalFile.clear();
+    journalFile.open(journalName, ios::binary | ios::app);
+    if (journalFile.tellp() == 0) {
+        journalFile.write(JOURNAL_FILE_MAGIC, sizeof(JOURNAL_FILE_MAGIC));
+        journalFile.write(reinterpret_cast<const char*>(&JOURNAL_FILE_VERSION), sizeof(JOURNAL_FILE_VERSION));
+        journalFile.flush();
+    }
+
+    error_code error;
+    spareJournal.close();
+    string spareName = journalName == JOURNAL_FILE ? JOURNAL_NEXT_FILE : JOURNAL_FILE;
+    if (!filesystem::exists(spareName, error)) openSpareJournal(spareJournal, spareName);
+}
+
+
+// Function to create an empty journal for a save to switch to
+void openSpareJournal(ofstream& file, const string& fileName) {
+    // Precondition: No file named 'fileName' holds records that are still needed.
+    // Post condition: 'file' is open on an empty journal named 'fileName' that starts with a valid header, or
+    //                 closed if it could not be created.
+
+    file.close();
+    file.clear();
+    file.open(fileName, ios::binary | ios::trunc);
+    file.write(JOURNAL_FILE_MAGIC, sizeof(JOURNAL_FILE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&JOURNAL_FILE_VERSION), sizeof(JOURNAL_FILE_VERSION));
+    file.flush();
+    if (!file) file.close();
+}
+
+
+// Function to find the sequence number a journal file starts at
+uint64_t firstJournalSeq(const string& fileName) {
+    // Precondition: None
+    // Post condition: Returns the sequence number of the file's first record, or UINT64_MAX if the file is missing
+    //                 or holds no intact record.
+
+    MappedFile file;
+    if (!mapFile(fileName, file)) return UINT64_MAX;
+    JournalRecord record;
+    uint64_t seq = UINT64_MAX;
+    if (file.size > JOURNAL_HEADER_SIZE && memcmp(file.data, JOURNAL_FILE_MAGIC, sizeof(JOURNAL_FILE_MAGIC)) == 0 &&
+        decodeJournalRecord(file.data + JOURNAL_HEADER_SIZE, file.size - JOURNAL_HEADER_SIZE, record) > 0) {
+        seq = record.seq;
+    }
+    unmapFile(file);
+    return seq;
+}
+
+
+// Function to fold the journal into the shards
+void compactJournal(CowVector<Task>& tasks) {
+    // Precondition: 'tasks' reflects every applied record in the journal and 'tasksMutex' is held.
+    // Post condition: The shards hold all tasks and the journal is empty; if writing the shards fails the journal is kept.
+
+    // While the shards are unloaded, nothing is pending and the format stays, the files on disk are already up to date
+    if (!shardStore.loaded && shardStore.pendingRecords.empty() && shardStore.compressed == compressSnapshots) return;
+    ensureTasksLoaded(tasks);
+
+    // Let a save the autosave thread is writing finish first, so the two never write the same shard
+    saveFinished.wait(tasksMutex, [] { return !saveInProgress; });
+
+    SaveJob job;
+    prepareSave(tasks, job);
+    finishSave(job, runSave(job));
+}
+
+
+// Function to sort the list in the given order
+void sortTasks(CowVector<Task>& tasks, SortKey key, const uint8_t* fields, vector<uint32_t>& order) {
+    // Precondition: With SORT_BY_FIELDS, 'fields' holds MAX_SORT_FIELDS sort fields.
+    // Post condition: 'tasks' is ordered by ascending priority, ascending due date or the given fields, and task i
+    //                 of the list is the task that was at 'order[i]'.
+
+    order.resize(tasks.size());
+    for (size_t i = 0; i < tasks.size(); ++i) order[i] = static_cast<uint32_t>(i);
+    if (key == SORT_BY_PRIORITY_EXCHANGE || key == SORT_BY_DUE_DATE_EXCHANGE) {
+        // The old exchange sort, kept so old journals replay to the same order; it swaps the sorted field and the
+        // position, not whole tasks
+        vector<uint32_t> values(tasks.size());
+        for (size_t i = 0; i < tasks.size(); ++i) values[i] = key == SORT_BY_PRIORITY_EXCHANGE ? tasks[i].priority : tasks[i].dueDay;
+        for (size_t i = 0; i < order.size(); ++i) {
+            for (size_t j = i + 1; j < order.size(); ++j) {
+                if (values[i] > values[j]) {
+                    swap(values[i], values[j]);
+                    swap(order[i], order[j]);
+                }
+            }
+        }
+        reorderTasks(tasks, order);
+        return;
+    }
+
+    uint8_t singleField[MAX_SORT_FIELDS] = {key == SORT_BY_PRIORITY ? SORT_FIELD_PRIORITY : SORT_FIELD_DUE_DATE};
+    if (key != SORT_BY_FIELDS) fields = singleField;
+
+    // Sort the positions by packed key and move every task just once, instead of swapping whole tasks
+    vector<uint64_t> keys(tasks.size());
+    for (size_t i = 0; i < tasks.size(); ++i) keys[i] = packSortKey(tasks[i], fields);
+    radixSortOrder(keys, order);
+    reorderTasks(tasks, order);
+}
+
+
+// Function to pack the sort fields of a task into one integer
+uint64_t packSortKey(const Task& task, const uint8_t* fields) {
+    // Precondition: 'fields' holds MAX_SORT_FIELDS sort fields.
+    // Post condition: Returns a key that orders tasks as the fields do, the first field in the highest bits. The
+    //                 priority takes 8 bits, the due day 22 and the status 1, so all three fit.
+
+    uint64_t key = 0;
+    for (size_t f = 0; f < MAX_SORT_FIELDS; ++f) {
+        uint64_t value = 0;
+        int width = 0;
+        switch (fields[f] & ~SORT_DESCENDING) {
+            case SORT_FIELD_PRIORITY:
+                value = task.priority;
+                width = 8;
+                break;
+            case SORT_FIELD_DUE_DATE:
+                value = task.dueDay;
+                width = 22;
+                break;
+            case SORT_FIELD_STATUS:
+                value = task.completed;
+                width = 1;
+                break;
+        }
+        uint64_t mask = (uint64_t(1) << width) - 1;
+        if (fields[f] & SORT_DESCENDING) value = mask - value;
+        key = key << width | value;
+    }
+    return key;
+}
+
+
+// Function to sort positions by their packed keys
+void radixSortOrder(vector<uint64_t>& keys, vector<uint32_t>& order) {
+    // Precondition: 'keys' and 'order' have the same size; keys[i] is the key of the task at order[i].
+    // Post condition: Both are ordered by ascending key; entries with equal keys keep their relative order.
+
+    // Least significant byte first, counting all eight bytes in one pass and skipping those every key shares
+    size_t count = keys.size();
+    vector<array<size_t, 256>> counts(8);
+    for (uint64_t key : keys) {
+        for (int digit = 0; digit < 8; ++digit) ++counts[digit][(key >> (digit * 8)) & 0xFF];
+    }
+    vector<uint64_t> keyBuffer(count);
+    vector<uint32_t> orderBuffer(count);
+    for (int digit = 0; digit < 8; ++digit) {
+        int shift = digit * 8;
+        if (count == 0 || counts[digit][(keys[0] >> shift) & 0xFF] == count) continue;
+        size_t next[256];
+        size_t total = 0;
+        for (int value = 0; value < 256; ++value) {
+            next[value] = total;
+            total += counts[digit][value];
+        }
+        for (size_t i = 0; i < count; ++i) {
+            size_t slot = next[(keys[i] >> shift) & 0xFF]++;
+            keyBuffer[slot] = keys[i];
+            orderBuffer[slot] = order[i];
+        }
+        keys.swap(keyBuffer);
+        order.swap(orderBuffer);
+    }
 }
 
 
-// Function to load tasks from a file
-void loadTasksFromFile(vector<Task>& tasks) {
-    // Precondition: The file "tasks.txt" must exist and be accessible for reading.
-    // Post condition: All tasks from the file "tasks.txt" are loaded into the 'tasks' vector.
+// Function to rearrange the list
+void reorderTasks(CowVector<Task>& tasks, const vector<uint32_t>& order) {
+    // Precondition: 'order' is a permutation of the positions in 'tasks'.
+    // Post condition: Task i of the list is the task that was at 'order[i]'.
+
+    // Building a new list copies each task once, where moving them in place would copy every shared chunk first
+    CowVector<Task> reordered;
+    for (uint32_t position : order) reordered.push_back(tasks[position]);
+    tasks = move(reordered);
+}
+
 
-    ifstream inFile("tasks.txt");  // Open the file for reading
-    if (!inFile) return;  // If the file cannot be opened, exit the function
+// Function to read sort fields typed as letters
+bool parseSortFields(string_view text, uint8_t* fields) {
+    // Precondition: 'fields' has room for MAX_SORT_FIELDS sort fields.
+    // Post condition: Returns true and fills 'fields' if 'text' is one to MAX_SORT_FIELDS different letters out of
+    //                 p (priority), d (due date) and s (status), capitals meaning descending; otherwise returns false.
 
-    Task task;
-    while (getline(inFile, task.title)) {
-        // Read each task's details from the file
-        getline(inFile, task.dueDate);
-        inFile >> task.priority >> task.completed;
-        inFile.ignore();  // Ignore the newline character after reading the task details
-        tasks.push_back(task);  // Add the task to the vector
+    if (text.empty() || text.size() > MAX_SORT_FIELDS) return false;
+    fill(fields, fields + MAX_SORT_FIELDS, SORT_FIELD_NONE);
+    for (size_t i = 0; i < text.size(); ++i) {
+        char letter = static_cast<char>(tolower(static_cast<unsigned char>(text[i])));
+        uint8_t field = letter == 'p' ? SORT_FIELD_PRIORITY : letter == 'd' ? SORT_FIELD_DUE_DATE
+                      : letter == 's' ? SORT_FIELD_STATUS : SORT_FIELD_NONE;
+        if (field == SORT_FIELD_NONE) return false;
+        for (size_t j = 0; j < i; ++j) {
+            if ((fields[j] & ~SORT_DESCENDING) == field) return false;
+        }
+        fields[i] = letter == text[i] ? field : field | SORT_DESCENDING;
     }
+    return true;
 }
 
 
 // Function to filter and sort tasks based on user choice
-void filterAndSortTasks(vector<Task>& tasks) {
+void filterAndSortTasks(CowVector<Task>& tasks) {
     int choice;
 
     // Precondition: The 'tasks' vector must be accessible and modifiable.
     // Post condition: Tasks are filtered or sorted based on the user's choice.
 
-    cout << "1. Filter by status (1: Completed, 0: Pending)" << endl;
+    cout << "1. Filter by a query, e.g. priority>=50 and due<2026-01-01 and not done" << endl;
     cout << "2. Sort by priority" << endl;
     cout << "3. Sort by due date" << endl;
+    cout << "4. Show tasks due between two dates" << endl;
+    cout << "5. Show overdue tasks" << endl;
+    cout << "6. Show the next tasks due" << endl;
+    cout << "7. Show the highest-priority pending task" << endl;
+    cout << "8. Show tasks at or above a priority" << endl;
+    cout << "9. Sort by several fields" << endl;
+    cout << "10. Filter by priority range, due date range and status" << endl;
+    cout << "11. Search task titles" << endl;
+    cout << "12. Show tasks in the order they were added" << endl;
+    cout << "13. Show task statistics" << endl;
     cout << "Enter your choice: " << endl;
-    cin >> choice;
+    readNumber(choice);
     cin.ignore();  // Ignore the newline character after the number input
 
-    if (choice == 1) {
-        bool status;
-        cout << "Enter status (1 for Completed, 0 for Pending): " << endl;
-        cin >> status;
-        cin.ignore();
-        for (size_t i = 0; i < tasks.size(); ++i) {
-            if (tasks[i].completed == status) {
-                cout << tasks[i].title << " | Due: " << tasks[i].dueDate
-                     << " | Priority: " << tasks[i].priority << endl;
+    // The shards are read the first time the list is needed. A due date listing reads only the months it covers
+    // while the list is not loaded; every other choice needs the whole list
+    if (choice < 4 || choice > 6) ensureTasksLoaded(tasks);
+
+    if (choice == 1 || choice == 10) {
+        // Filters scan the task columns rather than the tasks, so the titles stay out of the cache, unless an index
+        // narrows them down to a few tasks
+        TaskQuery query;
+        if (choice == 1) {
+            string text, error;
+            cout << "Enter a query. Compare priority or due (YYYY-MM-DD or today) with =, !=, <, <=, > or >=," << endl;
+            cout << "match done or pending tasks, and combine them with and, or, not and parentheses: " << endl;
+            while (readLine(text) && !compileQuery(text, query, error)) cout << "Invalid query: " << error << ". Try again: " << endl;
+            if (query.program.empty()) return;  // The input ended
+        } else {
+            TaskFilter filter;
+            // Each bound may be left blank to leave that side open
+            auto ask = [](const char* prompt, const function<bool(const string&)>& valid) {
+                string answer;
+                cout << prompt << endl;
+                while (readLine(answer) && !answer.empty() && !valid(answer)) cout << "Invalid value. Try again: " << endl;
+                return answer;
+            };
+            auto isPriority = [](const string& text) {
+                int value = 0;
+                auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+                return error == errc() && end == text.data() + text.size() && isValidPriority(value);
+            };
+            auto isStatus = [](const string& text) { return text == "0" || text == "1"; };
+            string answer = ask("Enter lowest priority (1-100, blank for any): ", isPriority);
+            if (!answer.empty()) filter.minPriority = static_cast<uint8_t>(stoi(answer));
+            answer = ask("Enter highest priority (1-100, blank for any): ", isPriority);
+            if (!answer.empty()) filter.maxPriority = static_cast<uint8_t>(stoi(answer));
+            answer = ask("Enter first due date (YYYY-MM-DD, blank for any): ", [](const string& text) { return isValidDate(text); });
+            if (!answer.empty()) filter.firstDay = dayNumber(answer);
+            answer = ask("Enter last due date (YYYY-MM-DD, blank for any): ", [](const string& text) { return isValidDate(text); });
+            if (!answer.empty()) filter.lastDay = dayNumber(answer);
+            answer = ask("Enter status (1 for Completed, 0 for Pending, blank for any): ", isStatus);
+            if (!answer.empty()) filter.minCompleted = filter.maxCompleted = answer == "1";
+            emitQueryTest(query, filter);
+        }
+
+        ensureTaskColumns(tasks);
+        ensureTaskIds(tasks);
+        vector<uint64_t> selection;
+        runQuery(query, selection);
+        size_t matches = 0;
+        for (size_t word = 0; word < selection.size(); ++word) {
+            for (uint64_t bits = selection[word]; bits != 0; bits &= bits - 1) {
+                printTaskRow(tasks, word * 64 + countr_zero(bits));
+                ++matches;
             }
         }
-    } else if (choice == 2) {
-        // Sort tasks by priority
-        for (size_t i = 0; i < tasks.size(); ++i) {
-            for (size_t j = i + 1; j < tasks.size(); ++j) {
-                if (tasks[i].priority > tasks[j].priority) {
-                    swap(tasks[i], tasks[j]);
-                }
+        if (matches == 0) {
+            cout << "No tasks found." << endl;
+        } else {
+            size_t completedCount = countCompleted(&selection);
+            cout << matches << (matches == 1 ? " task" : " tasks") << " found, " << completedCount << " completed ("
+                 << completedCount * 100 / matches << "%)" << endl;
+        }
+    } else if (choice == 2 || choice == 3 || choice == 9) {
+        // Sorting picks the view the list is shown in; the list keeps its order, so the task numbers, the shards
+        // and the indexes stay as they are and the view follows later changes without sorting again
+        uint8_t fields[MAX_SORT_FIELDS] = {choice == 2 ? SORT_FIELD_PRIORITY : SORT_FIELD_DUE_DATE};
+        if (choice == 9) {
+            string text;
+            cout << "Enter up to three fields, most important first: p (priority), d (due date), s (status)." << endl;
+            cout << "Use capitals to sort a field in descending order, e.g. Pd: " << endl;
+            readLine(text);
+            while (!parseSortFields(text, fields)) {
+                cout << "Invalid fields. Enter up to three different letters out of p, d and s: " << endl;
+                readLine(text);
             }
         }
-        cout << "Tasks sorted by priority." << endl;
-    } else if (choice == 3) {
-        // Sort tasks by due date
-        for (size_t i = 0; i < tasks.size(); ++i) {
-            for (size_t j = i + 1; j < tasks.size(); ++j) {
-                if (tasks[i].dueDate > tasks[j].dueDate) {
-                    swap(tasks[i], tasks[j]);
-                }
+        selectSortedView(fields);
+        cout << "Tasks sorted by " << sortFieldsText(fields) << "; View Tasks shows them in this order." << endl;
+    } else if (choice == 12) {
+        activeView = LIST_ORDER;
+        cout << "View Tasks shows the tasks in the order they were added." << endl;
+    } else if (choice == 13) {
+        showTaskStats(tasks);
+    } else if (choice >= 4 && choice <= 6) {
+        // Answered from the due date index, which leaves the order of the list alone
+        uint32_t first = 1;  // Skips tasks whose due date is malformed
+        uint32_t last = UINT32_MAX;
+        size_t limit = SIZE_MAX;
+        if (choice == 4) {
+            string from, to;
+            do {
+                cout << "Enter first due date (YYYY-MM-DD): " << endl;
+                readLine(from);
+            } while (!isValidDate(from));
+            do {
+                cout << "Enter last due date (YYYY-MM-DD): " << endl;
+                readLine(to);
+            } while (!isValidDate(to));
+            first = dayNumber(from);
+            last = dayNumber(to);
+        } else if (choice == 5) {
+            last = today() - 1;
+        } else {
+            first = today();
+            cout << "Enter how many tasks to show: " << endl;
+            if (!readNumber(limit)) {
+                cin.clear();
+                limit = 0;
+            }
+            cin.ignore(10000, '\n');
+        }
+
+        if (!shardStore.loaded && listDueTasksInShards(first, last, choice != 4, limit)) return;
+        ensureTasksLoaded(tasks);
+        ensureDueDateIndex(tasks);
+        ensureTaskIds(tasks);
+        vector<size_t> due;
+        findDueTasks(tasks, first, last, choice != 4, limit, due);
+        for (size_t position : due) printTaskRow(tasks, position);
+        if (due.empty()) cout << "No tasks found." << endl;
+    } else if (choice == 7 || choice == 8) {
+        // Answered from the priority index, which leaves the order of the list alone. The index is built once the
+        // input is in, since a compaction while the user types rebuilds it
+        int minPriority = MIN_PRIORITY;
+        if (choice == 8) {
+            cout << "Enter the lowest priority to show (1-100): " << endl;
+            while (!readNumber(minPriority) || !isValidPriority(minPriority)) {
+                cin.clear();
+                cin.ignore(10000, '\n');
+                cout << "Invalid priority. Please enter a number between 1 and 100: " << endl;
             }
+            cin.ignore();
+        }
+        ensurePriorityIndex(tasks);
+        ensureTaskIds(tasks);
+        vector<size_t> found;
+        if (choice == 7) {
+            size_t position = highestPendingTask();
+            if (position != NO_TASK) found.push_back(position);
+        } else {
+            findTasksByPriority(minPriority, false, found);
+        }
+        for (size_t position : found) printTaskRow(tasks, position);
+        if (found.empty()) cout << "No tasks found." << endl;
+    } else if (choice == 11) {
+        // Answered from the trigram index, so a search looks at the few titles that can match rather than all of them
+        string text;
+        cout << "Enter text to search for: " << endl;
+        while (readLine(text) && text.empty()) cout << "Enter at least one character: " << endl;
+        if (text.empty()) return;  // The input ended
+        ensureTrigramIndex(tasks);
+        ensureTaskIds(tasks);
+        vector<size_t> found;
+        searchTitles(tasks, text, found);
+        for (size_t position : found) printTaskRow(tasks, position);
+        if (found.empty()) {
+            cout << "No tasks found." << endl;
+            showSimilarTitles(tasks, text, NO_TASK);  // The whole title may have been typed with a slip
+        } else {
+            cout << found.size() << (found.size() == 1 ? " task" : " tasks") << " found." << endl;
         }
-        cout << "Tasks sorted by due date." << endl;
     } else {
         // Handle invalid choice
         cout << "Invalid choice." << endl;